@@ -0,0 +1,478 @@
+// Throughput benchmark for the lexer stages and the whole parser.
+//
+// Linux:
+//     g++ -std=c++17 -O2 -march=native -I../Inerpretator Benchmark.cpp ../Inerpretator/Parser.cpp -o benchmark -lpthread
+//
+// Usage: benchmark [--mix declarations|identifiers|numerics|whitespace|comments|mixed]
+//                  [--size MiB] [--reps N] [--warmup N] [--seed N]
+//
+// The same seed always generates the same program, so runs on different
+// revisions measure the same input.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Parser.h"
+
+
+namespace bench
+{
+	enum class EMix
+	{
+		Declarations,
+		Identifiers,
+		Numerics,
+		Whitespace,
+		Comments,
+		Mixed
+	};
+
+	struct Options
+	{
+		EMix mix = EMix::Mixed;
+		size_t size = 16 * 1024 * 1024;
+		uint32_t reps = 10;
+		uint32_t warmup = 2;
+		uint64_t seed = 1;
+	};
+
+	class Generator
+	{
+	public:
+		explicit Generator(const uint64_t seed) :
+			m_random(seed)
+		{
+
+		}
+
+		std::string generate(const EMix mix, const size_t size)
+		{
+			std::string program;
+			program.reserve(size + 256);
+			while (program.size() < size)
+			{
+				switch (mix == EMix::Mixed ? static_cast<EMix>(m_random() % 4) : mix)
+				{
+				case EMix::Declarations:
+					this->declaration(program, 8);
+					break;
+				case EMix::Identifiers:
+					this->declaration(program, 48 + m_random() % 80);
+					break;
+				case EMix::Numerics:
+					this->numerics(program);
+					break;
+				case EMix::Comments:
+					this->comments(program);
+					break;
+				default:
+					this->whitespace(program);
+					break;
+				}
+			}
+			return program;
+		}
+
+	private:
+		void identifier(std::string& program, const size_t length)
+		{
+			static const char first[] = "_abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+			static const char rest[] = "_abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+			program += first[m_random() % (sizeof(first) - 1)];
+			for (size_t i = 1; i < length; i++)
+			{
+				program += rest[m_random() % (sizeof(rest) - 1)];
+			}
+		}
+
+		void digits(std::string& program, const size_t max_length)
+		{
+			const size_t length = 1 + m_random() % max_length;
+			for (size_t i = 0; i < length; i++)
+			{
+				program += static_cast<char>('0' + m_random() % 10);
+			}
+		}
+
+		// Every form tree_numeric accepts: optional sign, integer part,
+		// optional '.', fraction and f/F/d/D suffix.
+		void numeric(std::string& program, const uint32_t form)
+		{
+			static const char* const signs[] = { "", "+", "-" };
+			static const char* const suffixes[] = { "", "f", "F", "d", "D" };
+			program += signs[form % 3];
+			const uint32_t shape = (form / 3) % 4;
+			const char* suffix = suffixes[(form / 12) % 5];
+			switch (shape)
+			{
+			case 0:
+				this->digits(program, 9);
+				return;
+			case 1:
+				this->digits(program, 9);
+				program += '.';
+				break;
+			case 2:
+				this->digits(program, 9);
+				program += '.';
+				this->digits(program, 9);
+				break;
+			default:
+				program += '.';
+				this->digits(program, 9);
+				break;
+			}
+			program += suffix;
+		}
+
+		void declaration(std::string& program, const size_t identifier_length)
+		{
+			static const char* const types[] = { "const int ", "const float ", "const double " };
+			const uint32_t type = m_random() % 3;
+			program += types[type];
+			this->identifier(program, identifier_length);
+			program += " = ";
+			if (type == 0)
+			{
+				this->numeric(program, m_random() % 3);
+			}
+			else
+			{
+				this->digits(program, 6);
+				program += '.';
+				this->digits(program, 6);
+				program += type == 1 ? "f" : "d";
+			}
+			program += " ;\n";
+		}
+
+		void numerics(std::string& program)
+		{
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				this->numeric(program, m_random() % 60);
+				program += ' ';
+			}
+			program += '\n';
+		}
+
+		void whitespace(std::string& program)
+		{
+			static const char spaces[] = " \t\n";
+			const size_t length = 16 + m_random() % 112;
+			for (size_t i = 0; i < length; i++)
+			{
+				program += spaces[m_random() % 3];
+			}
+			program += m_random() % 2 == 0 ? "{" : "}";
+		}
+
+		// A license-style block and a run of line comments, with the `;`, `*`
+		// and `/` that real commented-out code carries; the block leaves out
+		// '/' so it cannot close early.
+		void comments(std::string& program)
+		{
+			static const char text[] = "abcdefghijklmnopqrstuvwxyz  ;*=/";
+			program += "/*\n";
+			for (uint32_t line = 0; line < 4; line++)
+			{
+				program += " * ";
+				for (size_t i = 0, length = 40 + m_random() % 40; i < length; i++)
+				{
+					program += text[m_random() % (sizeof(text) - 2)];
+				}
+				program += '\n';
+			}
+			program += " */\n";
+			for (uint32_t line = 0; line < 4; line++)
+			{
+				program += "// ";
+				for (size_t i = 0, length = 20 + m_random() % 60; i < length; i++)
+				{
+					program += text[m_random() % (sizeof(text) - 1)];
+				}
+				program += '\n';
+			}
+			program += m_random() % 2 == 0 ? "{" : "}";
+			program += '\n';
+		}
+
+		std::mt19937_64 m_random;
+	};
+
+	// Sorted per-repetition timings, in seconds.
+	class Samples
+	{
+	public:
+		void add(const double seconds)
+		{
+			m_seconds.push_back(seconds);
+		}
+
+		double percentile(const double p)
+		{
+			std::sort(m_seconds.begin(), m_seconds.end());
+			const size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(m_seconds.size() - 1) + 0.5);
+			return m_seconds[rank];
+		}
+
+	private:
+		std::vector<double> m_seconds;
+	};
+
+	class Benchmark
+	{
+	public:
+		Benchmark(const Options& options, const prs::SourceBuffer& source) :
+			m_options(options),
+			m_source(source)
+		{
+			std::printf("%-28s %10s %10s %14s %10s %10s %10s\n",
+				"stage", "MB/s p50", "MB/s p10", "tokens/s p50", "ms p10", "ms p50", "ms p90");
+		}
+
+		// stage() returns the number of tokens it saw; the checksum keeps
+		// the work from being optimised away.
+		template <typename _Stage>
+		void run(const char* name, const _Stage& stage)
+		{
+			uint64_t tokens = 0;
+			for (uint32_t i = 0; i < m_options.warmup; i++)
+			{
+				tokens = stage();
+			}
+			Samples samples;
+			for (uint32_t i = 0; i < m_options.reps; i++)
+			{
+				const auto begin = std::chrono::steady_clock::now();
+				tokens = stage();
+				samples.add(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+				m_checksum += tokens;
+			}
+			const double megabytes = static_cast<double>(m_source.getLength()) / 1e6;
+			const double p10 = samples.percentile(10);
+			const double p50 = samples.percentile(50);
+			const double p90 = samples.percentile(90);
+			std::printf("%-28s %10.1f %10.1f %14.0f %10.2f %10.2f %10.2f\n",
+				name, megabytes / p50, megabytes / p90, static_cast<double>(tokens) / p50,
+				p10 * 1e3, p50 * 1e3, p90 * 1e3);
+		}
+
+		void consume(const uint64_t value)
+		{
+			m_checksum += value;
+		}
+
+		uint64_t getChecksum() const
+		{
+			return m_checksum;
+		}
+
+	private:
+		const Options& m_options;
+		const prs::SourceBuffer& m_source;
+		uint64_t m_checksum = 0;
+	};
+
+	bool parseOptions(const int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i + 1 < argc; i += 2)
+		{
+			const std::string key = argv[i];
+			const char* value = argv[i + 1];
+			if (key == "--mix")
+			{
+				const std::string mix = value;
+				options.mix = mix == "declarations" ? EMix::Declarations
+					: mix == "identifiers" ? EMix::Identifiers
+					: mix == "numerics" ? EMix::Numerics
+					: mix == "whitespace" ? EMix::Whitespace
+					: mix == "comments" ? EMix::Comments : EMix::Mixed;
+			}
+			else if (key == "--size")
+			{
+				options.size = static_cast<size_t>(std::strtod(value, nullptr) * 1024 * 1024);
+			}
+			else if (key == "--reps")
+			{
+				options.reps = std::max(1u, static_cast<uint32_t>(std::strtoul(value, nullptr, 10)));
+			}
+			else if (key == "--warmup")
+			{
+				options.warmup = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			}
+			else if (key == "--seed")
+			{
+				options.seed = std::strtoull(value, nullptr, 10);
+			}
+			else
+			{
+				return false;
+			}
+		}
+		return argc % 2 == 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bench::Options options;
+	if (!bench::parseOptions(argc, argv, options))
+	{
+		std::fprintf(stderr,
+			"usage: %s [--mix declarations|identifiers|numerics|whitespace|comments|mixed] "
+			"[--size MiB] [--reps N] [--warmup N] [--seed N]\n", argv[0]);
+		return 1;
+	}
+
+	const std::string program = bench::Generator(options.seed).generate(options.mix, options.size);
+	prs::SourceBuffer source;
+	source.assign(program.data(), program.size());
+	const char* const content = source.getData();
+	const char* const content_end = content + source.getLength();
+
+	prs::ParserAllocator allocator;
+	prs::DefinitionTokenStructureDictionaryTrees trees(allocator);
+	prs::TokenBuffer tokens;
+	tokens.reserveForInput(source.getLength());
+	prs::Lexer(trees).tokenize(content, source.getLength(), tokens);
+	std::printf("input %.1f MB, %zu tokens, seed %llu\n",
+		static_cast<double>(source.getLength()) / 1e6, tokens.size(), static_cast<unsigned long long>(options.seed));
+
+	bench::Benchmark benchmark(options, source);
+
+	benchmark.run("skip_space", [&]()
+	{
+		uint64_t words = 0;
+		const char* position = content;
+		while (true)
+		{
+			prs::_priv::skip_space(&position);
+			if (position >= content_end)
+			{
+				break;
+			}
+			words++;
+			while (position < content_end && !prs::_priv::is_space(*position))
+			{
+				position++;
+			}
+		}
+		return words;
+	});
+
+	const prs::Lexer lexer(trees);
+	benchmark.run("Lexer::tokenize", [&]()
+	{
+		prs::TokenBuffer buffer;
+		buffer.reserveForInput(source.getLength());
+		lexer.tokenize(content, source.getLength(), buffer);
+		return static_cast<uint64_t>(buffer.size());
+	});
+
+	// Each tree is asked at every token start, as the lexer does.
+	static const struct
+	{
+		const char* name;
+		prs::ETokenKind kind;
+	} kinds[] = {
+		{ "findByChars tree_type", prs::ETokenKind::Type },
+		{ "findByChars tree_numeric", prs::ETokenKind::Numeric },
+		{ "findByChars tree_assignment", prs::ETokenKind::Assignment },
+		{ "findByChars tree_semicolon", prs::ETokenKind::Semicolon },
+		{ "findByChars tree_bkt_open", prs::ETokenKind::BktFigureOpen },
+		{ "findByChars tree_bkt_close", prs::ETokenKind::BktFigureClose },
+		{ "findByChars tree_var_name", prs::ETokenKind::VariableName }
+	};
+	for (const auto& kind : kinds)
+	{
+		prs::DefinitionTokenStructureDictionaryTree& tree =
+			const_cast<prs::DefinitionTokenStructureDictionaryTree&>(prs::getTokenTree(trees, kind.kind));
+		benchmark.run(kind.name, [&]()
+		{
+			uint64_t matches = 0;
+			for (size_t i = 0; i < tokens.size(); i++)
+			{
+				prs::DefinitionTokenStructure* def_tok_struct = nullptr;
+				tree.findByChars(content + tokens.getOffset(i), &def_tok_struct);
+				matches += def_tok_struct != nullptr;
+			}
+			benchmark.consume(matches);
+			return static_cast<uint64_t>(tokens.size());
+		});
+	}
+
+	prs::DefinitionTokenStructureDictionaryTreesQueue* queue = allocator.createDefinitionTokenStructureDictionaryTreesQueue(
+		&trees.tree_type, &trees.tree_variable_name, &trees.tree_assignment, &trees.tree_numeric, &trees.tree_semicolon);
+	benchmark.run("TreesQueue::compare", [&]()
+	{
+		uint64_t declarations = 0;
+		for (size_t i = 0; i < tokens.size(); i++)
+		{
+			if (tokens.getKind(i) != prs::ETokenKind::Type)
+			{
+				continue;
+			}
+			const char* position = content + tokens.getOffset(i);
+			declarations += !queue->compare(&position).empty();
+		}
+		return declarations * 5;
+	});
+	benchmark.run("TreesQueue::match", [&]()
+	{
+		uint64_t declarations = 0;
+		uint32_t user_data[5];
+		for (size_t i = 0; i < tokens.size(); i++)
+		{
+			if (tokens.getKind(i) != prs::ETokenKind::Type)
+			{
+				continue;
+			}
+			const char* position = content + tokens.getOffset(i);
+			declarations += queue->match(&position, user_data, 5);
+		}
+		return declarations * 5;
+	});
+
+	prs::Parser parser;
+	benchmark.run("Parser::fromMemory", [&]()
+	{
+		return static_cast<uint64_t>(parser.fromMemory(content, source.getLength()).size());
+	});
+	prs::ThreadPool pool;
+	benchmark.run("Parser::fromMemory (pool)", [&]()
+	{
+		return static_cast<uint64_t>(parser.fromMemory(content, source.getLength(), pool).size());
+	});
+
+	// The same text as many small programs, cut at line ends.
+	std::vector<prs::MemoryInput> inputs;
+	for (size_t begin = 0; begin < source.getLength();)
+	{
+		const char* line_end = static_cast<const char*>(
+			std::memchr(content + std::min(begin + 4096, source.getLength()), '\n',
+				source.getLength() - std::min(begin + 4096, source.getLength())));
+		const size_t end = line_end != nullptr ? static_cast<size_t>(line_end - content) + 1 : source.getLength();
+		inputs.push_back({ content + begin, end - begin });
+		begin = end;
+	}
+	benchmark.run("Parser::fromMemory (batch)", [&]()
+	{
+		uint64_t count = 0;
+		for (const prs::ParseResult& result : parser.fromMemory(inputs, pool))
+		{
+			count += result.tokens.size();
+		}
+		return count;
+	});
+	std::printf("batch of %zu inputs: %.0f inputs/s, %.1f MB/s\n", inputs.size(),
+		parser.getBatchStats().getInputsPerSecond(), parser.getBatchStats().getBytesPerSecond() / 1e6);
+
+	std::printf("checksum %llu\n", static_cast<unsigned long long>(benchmark.getChecksum()));
+	return 0;
+}
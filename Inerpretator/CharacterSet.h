@@ -0,0 +1,256 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#if !defined(PRS_NO_SIMD)
+#if defined(__AVX2__)
+#define PRS_SIMD_AVX2
+#endif
+#if defined(__AVX2__) || defined(__AVX__) || defined(__SSSE3__)
+#define PRS_SIMD_SSSE3
+#endif
+#endif
+
+#if defined(PRS_SIMD_SSSE3)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Calling convention hint for MSVC x86; means nothing to other compilers.
+#if !defined(_MSC_VER) && !defined(__fastcall)
+#define __fastcall
+#endif
+
+// For the aligned loads of CharacterSet::span, which read past both ends of
+// the buffer but never into another page.
+#if defined(_MSC_VER)
+#define PRS_NO_SANITIZE_ADDRESS __declspec(no_sanitize_address)
+#elif defined(__GNUC__) || defined(__clang__)
+#define PRS_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define PRS_NO_SANITIZE_ADDRESS
+#endif
+
+
+namespace prs
+{
+	namespace _priv
+	{
+		inline uint32_t __fastcall trailing_zeros(const uint32_t mask)
+		{
+#if defined(_MSC_VER)
+			unsigned long index = 0;
+			_BitScanForward(&index, mask);
+			return static_cast<uint32_t>(index);
+#else
+			return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+		}
+
+		inline uint32_t __fastcall trailing_zeros64(const uint64_t mask)
+		{
+#if defined(_MSC_VER) && defined(_M_X64)
+			unsigned long index = 0;
+			_BitScanForward64(&index, mask);
+			return static_cast<uint32_t>(index);
+#elif defined(_MSC_VER)
+			const uint32_t low = static_cast<uint32_t>(mask);
+			return low != 0 ? trailing_zeros(low) : 32 + trailing_zeros(static_cast<uint32_t>(mask >> 32));
+#else
+			return static_cast<uint32_t>(__builtin_ctzll(mask));
+#endif
+		}
+	}
+
+	// 256-bit byte membership table. '\0' is never a member, so a span over
+	// a NUL-terminated buffer always stops at the terminator.
+	//
+	// The SIMD span uses the nibble lookup from Mula's byte-set test: the low
+	// nibble selects a row of high-nibble bits (one row for bytes < 0x80 and
+	// one for the rest) and the high nibble selects the bit inside the row.
+	// Loads are aligned, so the scan never crosses into an unmapped page.
+	class CharacterSet
+	{
+	public:
+		CharacterSet() = default;
+
+		CharacterSet(const char* chars, const uint32_t length)
+		{
+			for (uint32_t i = 0; i < length; i++)
+			{
+				this->add(chars[i]);
+			}
+		}
+
+		CharacterSet(const char* chars) :
+			CharacterSet(chars, static_cast<uint32_t>(strlen(chars)))
+		{
+
+		}
+
+		void add(const char c)
+		{
+			const uint8_t byte = static_cast<uint8_t>(c);
+			if (byte == 0)
+			{
+				return;
+			}
+			m_bits[byte >> 6] |= uint64_t(1) << (byte & 63);
+			m_nibbles[byte >> 7][byte & 0x0F] |= static_cast<uint8_t>(1 << ((byte >> 4) & 7));
+		}
+
+		bool contains(const char c) const
+		{
+			const uint8_t byte = static_cast<uint8_t>(c);
+			return ((m_bits[byte >> 6] >> (byte & 63)) & 1) != 0;
+		}
+
+		uint32_t spanScalar(const char* content) const
+		{
+			uint32_t length = 0;
+			while (this->contains(content[length]))
+			{
+				length++;
+			}
+			return length;
+		}
+
+		PRS_NO_SANITIZE_ADDRESS uint32_t span(const char* content) const
+		{
+#if defined(PRS_SIMD_AVX2)
+			const uint32_t misalign = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(content) & 31);
+			const char* block = content - misalign;
+			uint32_t stop = ~this->classify32(block) & (~0u << misalign);
+			while (stop == 0)
+			{
+				block += 32;
+				stop = ~this->classify32(block);
+			}
+			return static_cast<uint32_t>(block - content) + _priv::trailing_zeros(stop);
+#elif defined(PRS_SIMD_SSSE3)
+			const uint32_t misalign = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(content) & 15);
+			const char* block = content - misalign;
+			uint32_t stop = ~this->classify16(block) & (0xFFFFu << misalign) & 0xFFFFu;
+			while (stop == 0)
+			{
+				block += 16;
+				stop = ~this->classify16(block) & 0xFFFFu;
+			}
+			return static_cast<uint32_t>(block - content) + _priv::trailing_zeros(stop);
+#else
+			return this->spanScalar(content);
+#endif
+		}
+
+#if defined(PRS_SIMD_SSSE3)
+		PRS_NO_SANITIZE_ADDRESS uint32_t classify16(const char* block) const
+		{
+			const __m128i input = _mm_load_si128(reinterpret_cast<const __m128i*>(block));
+			const __m128i low_mask = _mm_set1_epi8(0x0F);
+			const __m128i high_bit = _mm_and_si128(input, _mm_set1_epi8(static_cast<char>(0x80)));
+			const __m128i low = _mm_and_si128(input, low_mask);
+			const __m128i high = _mm_and_si128(_mm_srli_epi16(input, 4), low_mask);
+			const __m128i row = _mm_or_si128(
+				_mm_shuffle_epi8(this->nibbles(0), _mm_or_si128(low, high_bit)),
+				_mm_shuffle_epi8(this->nibbles(1), _mm_or_si128(low, _mm_xor_si128(high_bit, _mm_set1_epi8(static_cast<char>(0x80))))));
+			const __m128i bit = _mm_shuffle_epi8(
+				_mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128), high);
+			return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(row, bit), bit)));
+		}
+#endif
+
+#if defined(PRS_SIMD_AVX2)
+		PRS_NO_SANITIZE_ADDRESS uint32_t classify32(const char* block) const
+		{
+			const __m256i input = _mm256_load_si256(reinterpret_cast<const __m256i*>(block));
+			const __m256i low_mask = _mm256_set1_epi8(0x0F);
+			const __m256i high_bit = _mm256_and_si256(input, _mm256_set1_epi8(static_cast<char>(0x80)));
+			const __m256i low = _mm256_and_si256(input, low_mask);
+			const __m256i high = _mm256_and_si256(_mm256_srli_epi16(input, 4), low_mask);
+			const __m256i row = _mm256_or_si256(
+				_mm256_shuffle_epi8(_mm256_broadcastsi128_si256(this->nibbles(0)), _mm256_or_si256(low, high_bit)),
+				_mm256_shuffle_epi8(_mm256_broadcastsi128_si256(this->nibbles(1)),
+					_mm256_or_si256(low, _mm256_xor_si256(high_bit, _mm256_set1_epi8(static_cast<char>(0x80))))));
+			const __m256i bit = _mm256_shuffle_epi8(
+				_mm256_setr_epi8(
+					1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+					1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128), high);
+			return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit)));
+		}
+#endif
+
+	private:
+#if defined(PRS_SIMD_SSSE3)
+		__m128i nibbles(const uint32_t half) const
+		{
+			return _mm_load_si128(reinterpret_cast<const __m128i*>(m_nibbles[half]));
+		}
+#endif
+
+		uint64_t m_bits[4] = {};
+		alignas(16) uint8_t m_nibbles[2][16] = {};
+	};
+
+	// Partition of the byte range into classes that none of the split
+	// predicates can tell apart. Tables indexed by class instead of by byte
+	// stay small and dense.
+	class ByteClasses
+	{
+	public:
+		ByteClasses() = default;
+
+		template <typename _Predicate>
+		void split(_Predicate member)
+		{
+			uint16_t remap[512];
+			for (uint32_t i = 0; i < 512; i++)
+			{
+				remap[i] = 0xFFFF;
+			}
+			uint32_t count = 0;
+			for (uint32_t b = 0; b < 256; b++)
+			{
+				const uint32_t key = m_classes[b] * 2u + (member(static_cast<char>(b)) ? 1u : 0u);
+				if (remap[key] == 0xFFFF)
+				{
+					remap[key] = static_cast<uint16_t>(count++);
+				}
+				m_classes[b] = static_cast<uint8_t>(remap[key]);
+			}
+			m_count = count;
+		}
+
+		void split(const CharacterSet& set)
+		{
+			this->split([&set](const char c) { return set.contains(c); });
+		}
+
+		uint8_t getClass(const char c) const
+		{
+			return m_classes[static_cast<uint8_t>(c)];
+		}
+
+		uint32_t getCount() const
+		{
+			return m_count;
+		}
+
+		char getRepresentative(const uint32_t byte_class) const
+		{
+			for (uint32_t b = 0; b < 256; b++)
+			{
+				if (m_classes[b] == byte_class)
+				{
+					return static_cast<char>(b);
+				}
+			}
+			return '\0';
+		}
+
+	private:
+		uint8_t m_classes[256] = {};
+		uint32_t m_count = 1;
+	};
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+
+namespace prs
+{
+	// A sequence with a hole at getGap(). Inserting and erasing at the hole
+	// cost only the items inserted; moving the hole costs the items it
+	// passes, so edits close to each other stay cheap however long the
+	// sequence is. The items after the hole are contiguous and followed by
+	// `padding` value-initialised items that are never written.
+	template <typename _Type>
+	class GapBuffer
+	{
+	public:
+		explicit GapBuffer(const size_t padding = 0) :
+			m_padding(padding)
+		{
+			this->clear();
+		}
+
+		// The hole is left at the front, so the whole sequence is after it.
+		void assign(const _Type* items, const size_t count)
+		{
+			const size_t capacity = count + count / 8 + 64;
+			m_items.assign(capacity + m_padding, _Type());
+			std::copy(items, items + count, m_items.begin() + (capacity - count));
+			m_capacity = capacity;
+			m_gap_begin = 0;
+			m_gap_end = capacity - count;
+		}
+
+		void clear()
+		{
+			this->assign(nullptr, 0);
+		}
+
+		size_t size() const
+		{
+			return m_capacity - (m_gap_end - m_gap_begin);
+		}
+
+		size_t getGap() const
+		{
+			return m_gap_begin;
+		}
+
+		const _Type& operator [] (const size_t index) const
+		{
+			return m_items[index < m_gap_begin ? index : index + (m_gap_end - m_gap_begin)];
+		}
+
+		_Type& operator [] (const size_t index)
+		{
+			return m_items[index < m_gap_begin ? index : index + (m_gap_end - m_gap_begin)];
+		}
+
+		// Item getGap() and all after it, then the padding.
+		const _Type* getAfterGap() const
+		{
+			return m_items.data() + m_gap_end;
+		}
+
+		void moveGap(const size_t index)
+		{
+			if (index < m_gap_begin)
+			{
+				const size_t count = m_gap_begin - index;
+				std::copy_backward(m_items.begin() + index, m_items.begin() + m_gap_begin, m_items.begin() + m_gap_end);
+				m_gap_begin -= count;
+				m_gap_end -= count;
+			}
+			else if (index > m_gap_begin)
+			{
+				const size_t count = index - m_gap_begin;
+				std::copy(m_items.begin() + m_gap_end, m_items.begin() + m_gap_end + count, m_items.begin() + m_gap_begin);
+				m_gap_begin += count;
+				m_gap_end += count;
+			}
+		}
+
+		// Removes the count items after the hole.
+		void erase(const size_t count)
+		{
+			m_gap_end += count;
+		}
+
+		// Inserts before the hole, so the items end up in call order.
+		void insert(const _Type* items, const size_t count)
+		{
+			this->reserveGap(count);
+			std::copy(items, items + count, m_items.begin() + m_gap_begin);
+			m_gap_begin += count;
+		}
+
+		void push(const _Type& item)
+		{
+			this->reserveGap(1);
+			m_items[m_gap_begin++] = item;
+		}
+
+	private:
+		void reserveGap(const size_t count)
+		{
+			if (m_gap_end - m_gap_begin >= count)
+			{
+				return;
+			}
+			const size_t after = m_capacity - m_gap_end;
+			const size_t capacity = std::max(m_capacity * 2, m_capacity + count);
+			std::vector<_Type> items(capacity + m_padding, _Type());
+			std::copy(m_items.begin(), m_items.begin() + m_gap_begin, items.begin());
+			std::copy(m_items.begin() + m_gap_end, m_items.begin() + m_capacity, items.begin() + (capacity - after));
+			m_items.swap(items);
+			m_capacity = capacity;
+			m_gap_end = capacity - after;
+		}
+
+		std::vector<_Type> m_items;
+		size_t m_padding;
+		size_t m_capacity = 0;
+		size_t m_gap_begin = 0;
+		size_t m_gap_end = 0;
+	};
+}
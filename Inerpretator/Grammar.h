@@ -0,0 +1,150 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "Lexer.h"
+#include "GrammarImage.h"
+#include "StatementTable.h"
+#include "StaticAutomaton.h"
+
+
+namespace prs
+{
+	// Trees builds the built-in trees at run time; Builtin uses the tables
+	// StaticAutomaton built at compile time.
+	enum class EGrammarSource
+	{
+		Trees,
+		Builtin
+	};
+
+	// The token trees, their automata and the statement forms, built once
+	// and read-only from then on, so any number of parsers on any number of
+	// threads may share one. Nothing is mutated after construction but the
+	// PRS_STATS counters, which are atomics.
+	class Grammar
+	{
+	public:
+		static constexpr ETokenKind declaration[] = {
+			ETokenKind::Type,
+			ETokenKind::VariableName,
+			ETokenKind::Assignment,
+			ETokenKind::Numeric,
+			ETokenKind::Semicolon
+		};
+		static constexpr ETokenKind empty[] = { ETokenKind::Semicolon };
+		static constexpr ETokenKind block_open[] = { ETokenKind::BktFigureOpen };
+		static constexpr ETokenKind block_close[] = { ETokenKind::BktFigureClose };
+
+		Grammar() :
+			m_trees(new DefinitionTokenStructureDictionaryTrees(m_allocator)),
+			m_automata(getTokenAutomata(*m_trees))
+		{
+			this->addStatements();
+		}
+
+		// Builtin takes the automata from the tables StaticAutomaton.h
+		// compiled into the program: no trees, nothing built on the heap.
+		explicit Grammar(const EGrammarSource source)
+		{
+			this->addStatements();
+			if (source == EGrammarSource::Builtin)
+			{
+				m_automata = assignBuiltinAutomata(m_builtin);
+#if defined(PRS_STATS)
+				for (uint32_t i = 0; i < token_trees_count; i++)
+				{
+					m_builtin[i].setCounters(&m_counters[i]);
+				}
+#endif
+				return;
+			}
+			m_trees.reset(new DefinitionTokenStructureDictionaryTrees(m_allocator));
+			m_automata = getTokenAutomata(*m_trees);
+		}
+
+		// Takes the automata from a GrammarImage file; if it cannot be
+		// loaded the trees are built as usual.
+		explicit Grammar(const std::string& image_path)
+		{
+			this->addStatements();
+			if (m_image.load(image_path))
+			{
+				m_automata = m_image.getAutomata();
+				return;
+			}
+			m_trees.reset(new DefinitionTokenStructureDictionaryTrees(m_allocator));
+			m_automata = getTokenAutomata(*m_trees);
+		}
+
+		Grammar(const Grammar&) = delete;
+		Grammar& operator = (const Grammar&) = delete;
+
+		// The built-in grammar from static tables, set up on first use; the
+		// initialisation itself is thread-safe.
+		static const Grammar& getDefault()
+		{
+			static const Grammar grammar(EGrammarSource::Builtin);
+			return grammar;
+		}
+
+		// One automaton per tree, in ETokenKind order.
+		const TokenAutomata& getAutomata() const
+		{
+			return m_automata;
+		}
+
+		// nullptr for a grammar loaded from an image or the built-in one.
+		const DefinitionTokenStructureDictionaryTrees* getTrees() const
+		{
+			return m_trees.get();
+		}
+
+		// Matcher counters of one tree; zeros unless PRS_STATS, and for a
+		// grammar loaded from an image.
+		MatchStats getStats(const ETokenKind kind) const
+		{
+			if (m_trees != nullptr)
+			{
+				return getTokenTree(*m_trees, kind).getStats();
+			}
+#if defined(PRS_STATS)
+			if (m_image.isLoaded())
+			{
+				return {};
+			}
+			return m_counters[static_cast<uint32_t>(kind)].snapshot();
+#else
+			return {};
+#endif
+		}
+
+		const StatementTable& getStatements() const
+		{
+			return m_statements;
+		}
+
+		// For adding forms, before the grammar is shared. `;` and `}` may
+		// only end a form: the parallel parse cuts the input after them.
+		StatementTable& getStatements()
+		{
+			return m_statements;
+		}
+
+	private:
+		void addStatements()
+		{
+			m_statements.add(EStatement::Declaration, declaration);
+			m_statements.add(EStatement::Empty, empty);
+			m_statements.add(EStatement::BlockOpen, block_open);
+			m_statements.add(EStatement::BlockClose, block_close);
+		}
+
+		ParserAllocator m_allocator;
+		std::unique_ptr<DefinitionTokenStructureDictionaryTrees> m_trees;
+		GrammarImage m_image;
+		DefinitionTokenStructureAutomaton m_builtin[token_trees_count];
+		PRS_STATS_ONLY(mutable MatchCounters m_counters[token_trees_count];)
+		TokenAutomata m_automata = {};
+		StatementTable m_statements;
+	};
+}
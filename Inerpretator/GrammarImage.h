@@ -0,0 +1,316 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <vector>
+#include "Lexer.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+namespace prs
+{
+	namespace _priv
+	{
+		constexpr char grammar_image_magic[8] = { 'P', 'R', 'S', 'G', 'R', 'A', 'M', '\0' };
+		constexpr uint32_t grammar_image_version = 2;
+		constexpr uint32_t grammar_image_endian = 0x01020304;
+
+		struct GrammarImageHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t endian;
+			uint32_t automata_count;
+			uint32_t reserved;
+			uint64_t size;
+		};
+
+		// Offsets are from the start of the image, so the image can be used
+		// wherever it is mapped.
+		struct GrammarImageAutomaton
+		{
+			uint32_t classes_count;
+			uint32_t states_count;
+			uint32_t accept_states_count;
+			uint32_t reserved;
+			uint64_t byte_classes;
+			uint64_t transitions;
+			uint64_t accepts;
+			uint64_t accept_states;
+		};
+
+		inline size_t __fastcall grammar_image_align(const size_t size)
+		{
+			return (size + 7) & ~static_cast<size_t>(7);
+		}
+	}
+
+	// The compiled automata of every token tree in one position-independent
+	// blob: a header, a directory with one entry per tree in ETokenKind order,
+	// then the byte classes, transitions, accepts and accept states of each
+	// automaton, every section 8-byte aligned. Loading maps the file once and
+	// points the automata into it; nothing inside the blob is patched, so
+	// startup does not build lexemes, tries or DFAs.
+	class GrammarImage
+	{
+	public:
+		GrammarImage() = default;
+
+		GrammarImage(const GrammarImage&) = delete;
+		GrammarImage& operator = (const GrammarImage&) = delete;
+
+		~GrammarImage()
+		{
+			this->release();
+		}
+
+		static std::vector<char> build(const DefinitionTokenStructureDictionaryTrees& trees)
+		{
+			const TokenAutomata automata = getTokenAutomata(trees);
+			size_t size = _priv::grammar_image_align(
+				sizeof(_priv::GrammarImageHeader) + sizeof(_priv::GrammarImageAutomaton) * token_trees_count);
+			_priv::GrammarImageAutomaton entries[token_trees_count] = {};
+			for (uint32_t i = 0; i < token_trees_count; i++)
+			{
+				const DefinitionTokenStructureAutomaton& automaton = *automata[i];
+				const size_t cells = static_cast<size_t>(automaton.getStatesCount()) * automaton.getClassesCount();
+				_priv::GrammarImageAutomaton& entry = entries[i];
+				entry.classes_count = automaton.getClassesCount();
+				entry.states_count = automaton.getStatesCount();
+				entry.accept_states_count = automaton.getAcceptStatesCount();
+				entry.byte_classes = size;
+				size += _priv::grammar_image_align(256);
+				entry.transitions = size;
+				size += _priv::grammar_image_align(cells * sizeof(uint32_t));
+				entry.accepts = size;
+				size += _priv::grammar_image_align(cells * sizeof(int32_t));
+				entry.accept_states = size;
+				size += _priv::grammar_image_align(
+					entry.accept_states_count * sizeof(DefinitionTokenStructureAutomaton::AcceptState));
+			}
+
+			std::vector<char> image(size, '\0');
+			_priv::GrammarImageHeader header = {};
+			memcpy(header.magic, _priv::grammar_image_magic, sizeof(header.magic));
+			header.version = _priv::grammar_image_version;
+			header.endian = _priv::grammar_image_endian;
+			header.automata_count = token_trees_count;
+			header.size = size;
+			memcpy(image.data(), &header, sizeof(header));
+			memcpy(image.data() + sizeof(header), entries, sizeof(entries));
+			for (uint32_t i = 0; i < token_trees_count; i++)
+			{
+				const DefinitionTokenStructureAutomaton& automaton = *automata[i];
+				const size_t cells = static_cast<size_t>(automaton.getStatesCount()) * automaton.getClassesCount();
+				memcpy(image.data() + entries[i].byte_classes, automaton.getByteClasses(), 256);
+				if (cells != 0)
+				{
+					memcpy(image.data() + entries[i].transitions, automaton.getTransitions(), cells * sizeof(uint32_t));
+					memcpy(image.data() + entries[i].accepts, automaton.getAccepts(), cells * sizeof(int32_t));
+				}
+				if (entries[i].accept_states_count != 0)
+				{
+					memcpy(image.data() + entries[i].accept_states, automaton.getAcceptStates(),
+						entries[i].accept_states_count * sizeof(DefinitionTokenStructureAutomaton::AcceptState));
+				}
+			}
+			return image;
+		}
+
+		static bool save(const DefinitionTokenStructureDictionaryTrees& trees, const std::string& file_path)
+		{
+			const std::vector<char> image = build(trees);
+			std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+			return file.write(image.data(), static_cast<std::streamsize>(image.size())).good();
+		}
+
+		bool load(const std::string& file_path)
+		{
+#if defined(__linux__)
+			this->release();
+			const int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+			{
+				return false;
+			}
+			struct stat file_stat;
+			if (::fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size == 0)
+			{
+				::close(fd);
+				return false;
+			}
+			const size_t length = static_cast<size_t>(file_stat.st_size);
+			void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (mapping == MAP_FAILED)
+			{
+				return false;
+			}
+			m_mapping = mapping;
+			m_mapping_length = length;
+			if (!this->bind(static_cast<const char*>(mapping), length))
+			{
+				this->release();
+				return false;
+			}
+			return true;
+#else
+			this->release();
+			std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+			if (!file)
+			{
+				return false;
+			}
+			const size_t length = static_cast<size_t>(file.tellg());
+			file.seekg(0);
+			m_heap.assign((length + 7) / 8, 0);
+			if (!file.read(reinterpret_cast<char*>(m_heap.data()), static_cast<std::streamsize>(length)) ||
+				!this->bind(reinterpret_cast<const char*>(m_heap.data()), length))
+			{
+				this->release();
+				return false;
+			}
+			return true;
+#endif
+		}
+
+		// Copies the image into an aligned buffer the GrammarImage owns.
+		bool assign(const char* image, const size_t length)
+		{
+			this->release();
+			m_heap.assign((length + 7) / 8, 0);
+			memcpy(m_heap.data(), image, length);
+			if (!this->bind(reinterpret_cast<const char*>(m_heap.data()), length))
+			{
+				this->release();
+				return false;
+			}
+			return true;
+		}
+
+		// Valid while the image is loaded, in ETokenKind order.
+		const TokenAutomata& getAutomata() const
+		{
+			return m_automata_pointers;
+		}
+
+		bool isLoaded() const
+		{
+			return m_automata_pointers[0] != nullptr;
+		}
+
+	private:
+		// Only reads: an image that fails any check is rejected as a whole.
+		bool bind(const char* image, const size_t length)
+		{
+			_priv::GrammarImageHeader header;
+			if (length < sizeof(header))
+			{
+				return false;
+			}
+			memcpy(&header, image, sizeof(header));
+			if (memcmp(header.magic, _priv::grammar_image_magic, sizeof(header.magic)) != 0 ||
+				header.version != _priv::grammar_image_version ||
+				header.endian != _priv::grammar_image_endian ||
+				header.automata_count != token_trees_count ||
+				header.size != length ||
+				length < sizeof(header) + sizeof(_priv::GrammarImageAutomaton) * token_trees_count)
+			{
+				return false;
+			}
+
+			const _priv::GrammarImageAutomaton* entries =
+				reinterpret_cast<const _priv::GrammarImageAutomaton*>(image + sizeof(header));
+			for (uint32_t i = 0; i < token_trees_count; i++)
+			{
+				const _priv::GrammarImageAutomaton& entry = entries[i];
+				const uint64_t cells = static_cast<uint64_t>(entry.states_count) * entry.classes_count;
+				if (entry.classes_count > 256 ||
+					(entry.classes_count != 0 && entry.states_count <= DefinitionTokenStructureAutomaton::start_state) ||
+					!inside(entry.byte_classes, 256, length) ||
+					!inside(entry.transitions, cells * sizeof(uint32_t), length) ||
+					!inside(entry.accepts, cells * sizeof(int32_t), length) ||
+					!inside(entry.accept_states,
+						entry.accept_states_count * sizeof(DefinitionTokenStructureAutomaton::AcceptState), length))
+				{
+					return false;
+				}
+
+				const uint8_t* byte_classes = reinterpret_cast<const uint8_t*>(image + entry.byte_classes);
+				const uint32_t* transitions = reinterpret_cast<const uint32_t*>(image + entry.transitions);
+				const int32_t* accepts = reinterpret_cast<const int32_t*>(image + entry.accepts);
+				for (uint32_t b = 0; b < 256; b++)
+				{
+					if (entry.classes_count != 0 && byte_classes[b] >= entry.classes_count)
+					{
+						return false;
+					}
+				}
+				for (uint64_t cell = 0; cell < cells; cell++)
+				{
+					if (transitions[cell] >= entry.states_count ||
+						accepts[cell] < -1 || accepts[cell] >= static_cast<int64_t>(entry.accept_states_count))
+					{
+						return false;
+					}
+				}
+				// scan() stops only on the dead state: every state must go
+				// there on the '\0' after the text, or it reads on past it.
+				for (uint32_t state = 0; entry.classes_count != 0 && state < entry.states_count; state++)
+				{
+					if (transitions[static_cast<uint64_t>(state) * entry.classes_count + byte_classes[0]]
+						!= DefinitionTokenStructureAutomaton::dead_state)
+					{
+						return false;
+					}
+				}
+
+				m_automata[i].assign(
+					byte_classes,
+					entry.classes_count,
+					entry.states_count,
+					transitions,
+					accepts,
+					reinterpret_cast<const DefinitionTokenStructureAutomaton::AcceptState*>(image + entry.accept_states),
+					entry.accept_states_count
+				);
+				m_automata_pointers[i] = &m_automata[i];
+			}
+			return true;
+		}
+
+		// Sections are 8-byte aligned so that bind may read them in place
+		// as uint32_t, int32_t and AcceptState arrays.
+		static bool inside(const uint64_t offset, const uint64_t size, const size_t length)
+		{
+			return offset % 8 == 0 && offset <= length && size <= length - offset;
+		}
+
+		void release()
+		{
+#if defined(__linux__)
+			if (m_mapping != nullptr)
+			{
+				::munmap(m_mapping, m_mapping_length);
+			}
+#endif
+			m_mapping = nullptr;
+			m_mapping_length = 0;
+			m_heap.clear();
+			m_automata_pointers.fill(nullptr);
+		}
+
+		std::vector<uint64_t> m_heap;
+		void* m_mapping = nullptr;
+		size_t m_mapping_length = 0;
+		DefinitionTokenStructureAutomaton m_automata[token_trees_count];
+		TokenAutomata m_automata_pointers = {};
+	};
+}
@@ -0,0 +1,232 @@
+#pragma once
+#include <vector>
+#include "GapBuffer.h"
+#include "Lexer.h"
+#include "Grammar.h"
+#include "SourceBuffer.h"
+
+
+namespace prs
+{
+	// Keeps a source text, its tokens and the grammar between edits. An edit
+	// re-lexes from two tokens before it, since a token may have looked past
+	// its own end (`const` decides whether it is a type only after the next
+	// word), and stops as soon as a new token starts where a shifted old
+	// token after the edit starts: from there on the text and therefore the
+	// tokens are the same. Symbol ids stay stable across edits.
+	// The text and the token columns are gap buffers with the gap at the
+	// last edit, and tokens after the gap keep their distance from the end
+	// of the text, which an edit before them does not change. An edit then
+	// costs its own size, the tokens re-lexed and the distance from the
+	// previous edit, not the length of the file.
+	class IncrementalLexer
+	{
+	public:
+		// Tokens [first, first + removed_count) were replaced by
+		// [first, first + inserted_count); later tokens only moved.
+		struct Change
+		{
+			size_t first;
+			size_t removed_count;
+			size_t inserted_count;
+		};
+
+		explicit IncrementalLexer(const Grammar& grammar = Grammar::getDefault()) :
+			m_lexer(grammar.getAutomata().data(), &m_symbols),
+			m_content(SourceBuffer::padding)
+		{
+
+		}
+
+		IncrementalLexer(const IncrementalLexer&) = delete;
+		IncrementalLexer& operator = (const IncrementalLexer&) = delete;
+
+		void reset(const char* content, const size_t content_length)
+		{
+			m_content.assign(content, content_length);
+			m_length = content_length;
+			m_symbols.clear();
+			TokenBuffer tokens;
+			tokens.reserveForInput(content_length);
+			m_lexer.tokenize(m_content.getAfterGap(), m_length, tokens);
+
+			m_kinds.clear();
+			m_offsets.clear();
+			m_lengths.clear();
+			m_user_data.clear();
+			for (size_t i = 0; i < tokens.size(); i++)
+			{
+				this->pushToken(tokens.getToken(i));
+			}
+			m_view_valid = false;
+		}
+
+		Change edit(size_t offset, size_t removed_length, const char* inserted, const size_t inserted_length)
+		{
+			offset = std::min(offset, m_length);
+			removed_length = std::min(removed_length, m_length - offset);
+			const size_t count = m_kinds.size();
+
+			const size_t before = this->findToken(0, offset);
+			const size_t first = before > 2 ? before - 2 : 0;
+			const size_t restart = first == 0 ? 0 : static_cast<size_t>(this->getOffset(first));
+			size_t old = this->findToken(first, offset + removed_length);
+
+			// Tokens from first on go after the gap, so the length change
+			// below moves them all at once.
+			this->moveTokensGap(first);
+			m_content.moveGap(offset);
+			m_content.erase(removed_length);
+			m_content.insert(inserted, inserted_length);
+			m_length = m_length - removed_length + inserted_length;
+			m_content.moveGap(restart);
+			const uint64_t edit_end = offset + inserted_length;
+
+			const char* const content_begin = m_content.getAfterGap();
+			const char* const content_end = content_begin + (m_length - restart);
+			const char* content = content_begin;
+			m_relexed.clear();
+			while (true)
+			{
+				_priv::skip_trivia(&content, content_end);
+				if (content >= content_end)
+				{
+					old = count;
+					break;
+				}
+				const uint64_t position = restart + static_cast<uint64_t>(content - content_begin);
+				if (position >= edit_end)
+				{
+					while (old < count && this->getOffset(old) < position)
+					{
+						old++;
+					}
+					if (old < count && this->getOffset(old) == position)
+					{
+						break;
+					}
+				}
+				m_relexed.push(m_lexer.next(content, content_end, position));
+				content += m_relexed.getLength(m_relexed.size() - 1);
+			}
+
+			m_kinds.erase(old - first);
+			m_offsets.erase(old - first);
+			m_lengths.erase(old - first);
+			m_user_data.erase(old - first);
+			for (size_t i = 0; i < m_relexed.size(); i++)
+			{
+				this->pushToken(m_relexed.getToken(i));
+			}
+			m_view_valid = false;
+			return { first, old - first, m_relexed.size() };
+		}
+
+		// Contiguous text followed by SourceBuffer::padding zero bytes,
+		// valid until the next edit. Moves the text gap to the front, so it
+		// costs the distance from the last edit.
+		const char* getData() const
+		{
+			m_content.moveGap(0);
+			return m_content.getAfterGap();
+		}
+
+		size_t getLength() const
+		{
+			return m_length;
+		}
+
+		size_t getTokensCount() const
+		{
+			return m_kinds.size();
+		}
+
+		Token getToken(const size_t index) const
+		{
+			return { static_cast<ETokenKind>(m_kinds[index]), this->getOffset(index), m_lengths[index], m_user_data[index] };
+		}
+
+		// All tokens at once, copied on the first call after an edit; a
+		// caller that reads a few tokens per edit should use getToken.
+		const TokenBuffer& getTokens() const
+		{
+			if (!m_view_valid)
+			{
+				m_view.clear();
+				m_view.reserve(m_kinds.size());
+				for (size_t i = 0; i < m_kinds.size(); i++)
+				{
+					m_view.push(this->getToken(i));
+				}
+				m_view_valid = true;
+			}
+			return m_view;
+		}
+
+		const SymbolTable& getSymbols() const
+		{
+			return m_symbols;
+		}
+
+	private:
+		uint64_t getOffset(const size_t index) const
+		{
+			return index < m_offsets.getGap() ? m_offsets[index] : m_length - m_offsets[index];
+		}
+
+		// First token in [from, count) that starts at or after offset.
+		size_t findToken(size_t from, const uint64_t offset) const
+		{
+			size_t to = m_kinds.size();
+			while (from < to)
+			{
+				const size_t middle = from + (to - from) / 2;
+				if (this->getOffset(middle) < offset)
+				{
+					from = middle + 1;
+				}
+				else
+				{
+					to = middle;
+				}
+			}
+			return from;
+		}
+
+		// An offset that crosses the gap switches between counting from the
+		// start and from the end; the same subtraction does both.
+		void moveTokensGap(const size_t index)
+		{
+			const size_t gap = m_kinds.getGap();
+			m_kinds.moveGap(index);
+			m_offsets.moveGap(index);
+			m_lengths.moveGap(index);
+			m_user_data.moveGap(index);
+			for (size_t i = std::min(gap, index); i < std::max(gap, index); i++)
+			{
+				m_offsets[i] = m_length - m_offsets[i];
+			}
+		}
+
+		// At the gap, so the offset is kept from the start.
+		void pushToken(const Token& token)
+		{
+			m_kinds.push(static_cast<uint8_t>(token.kind));
+			m_offsets.push(token.offset);
+			m_lengths.push(token.length);
+			m_user_data.push(token.user_data);
+		}
+
+		SymbolTable m_symbols;
+		Lexer m_lexer;
+		mutable GapBuffer<char> m_content;
+		size_t m_length = 0;
+		GapBuffer<uint8_t> m_kinds;
+		GapBuffer<uint64_t> m_offsets;
+		GapBuffer<uint32_t> m_lengths;
+		GapBuffer<uint32_t> m_user_data;
+		TokenBuffer m_relexed;
+		mutable TokenBuffer m_view;
+		mutable bool m_view_valid = false;
+	};
+}
@@ -1,10 +1,52 @@
 ﻿#include <iostream>
 #include "Parser.h"
+#include "VirtualMachine.h"
 
 int main()
 {
+    prs::SourceBuffer source;
+    if (!source.mapFile("programm.txt"))
+    {
+        return 1;
+    }
+
     prs::Parser parser;
-    parser.fromFile("programm.txt");
+    const prs::TokenBuffer tokens = parser.fromMemory(source.getData(), source.getLength());
+
+    for (const prs::Diagnostic& diagnostic : parser.getDiagnostics())
+    {
+        const prs::SourceLocation location = source.getLocation(diagnostic.offset);
+        std::cerr << "\nsyntax error at line " << location.line << ", column " << location.column;
+    }
+
+    prs::BytecodeProgram program;
+    if (!prs::BytecodeCompiler().compile(source.getData(), tokens, parser.getDeclarations(), program))
+    {
+        std::cerr << "\nnumeric constant out of range of its type";
+    }
+    prs::VirtualMachine vm;
+    vm.run(program);
+
+    for (const prs::BytecodeVariable& variable : program.variables)
+    {
+        const prs::RegisterValue& value = vm.getRegister(variable.reg);
+        std::cout << '\n' << variable.name << " = ";
+        switch (variable.type)
+        {
+        case prs::ENumericTypeTraits::SLong:
+            std::cout << value.s_long;
+            break;
+        case prs::ENumericTypeTraits::Float:
+            std::cout << value.f;
+            break;
+        case prs::ENumericTypeTraits::Double:
+            std::cout << value.d;
+            break;
+        default:
+            std::cout << value.s_int;
+            break;
+        }
+    }
 
     //prs::Lexeme* lex = new prs::ExpressionLexeme("0123456789");
     //prs::Lexeme lex1("HELLO");
@@ -0,0 +1,581 @@
+#pragma once
+#include <array>
+#include <deque>
+#include "deftok.h"
+#include "SymbolTable.h"
+
+
+namespace prs
+{
+	// Token kinds in the order the trees are tried when a span could be
+	// read as more than one kind, e.g. "12" is Numeric, not VariableName.
+	enum class ETokenKind : uint32_t
+	{
+		Type,
+		Numeric,
+		Assignment,
+		Semicolon,
+		BktFigureOpen,
+		BktFigureClose,
+		VariableName,
+		Unknown
+	};
+
+	constexpr uint32_t token_trees_count = static_cast<uint32_t>(ETokenKind::Unknown);
+
+	struct Token
+	{
+		ETokenKind kind;
+		uint64_t offset;
+		uint32_t length;
+		uint32_t user_data;
+	};
+
+	inline const DefinitionTokenStructureDictionaryTree& getTokenTree(
+		const DefinitionTokenStructureDictionaryTrees& trees,
+		const ETokenKind kind
+	)
+	{
+		switch (kind)
+		{
+		case ETokenKind::Type:
+			return trees.tree_type;
+		case ETokenKind::Numeric:
+			return trees.tree_numeric;
+		case ETokenKind::Assignment:
+			return trees.tree_assignment;
+		case ETokenKind::Semicolon:
+			return trees.tree_semicolon;
+		case ETokenKind::BktFigureOpen:
+			return trees.tree_bkt_figure_open;
+		case ETokenKind::BktFigureClose:
+			return trees.tree_bkt_figure_close;
+		default:
+			return trees.tree_variable_name;
+		}
+	}
+
+	using TokenAutomata = std::array<const DefinitionTokenStructureAutomaton*, token_trees_count>;
+
+	inline TokenAutomata getTokenAutomata(const DefinitionTokenStructureDictionaryTrees& trees)
+	{
+		TokenAutomata automata;
+		for (uint32_t i = 0; i < token_trees_count; i++)
+		{
+			automata[i] = &getTokenTree(trees, static_cast<ETokenKind>(i)).getAutomaton();
+		}
+		return automata;
+	}
+
+	// Struct-of-arrays token storage: one column per field, so a pass that
+	// only needs kinds or offsets walks one dense array.
+	class TokenBuffer
+	{
+	public:
+		TokenBuffer() = default;
+
+		void reserve(const size_t count)
+		{
+			m_kinds.reserve(count);
+			m_offsets.reserve(count);
+			m_lengths.reserve(count);
+			m_user_data.reserve(count);
+		}
+
+		// Declarations average well over four bytes per token.
+		void reserveForInput(const size_t content_length)
+		{
+			this->reserve(this->size() + content_length / 4 + 16);
+		}
+
+		void push(const ETokenKind kind, const uint64_t offset, const uint32_t length, const uint32_t user_data)
+		{
+			m_kinds.push_back(static_cast<uint8_t>(kind));
+			m_offsets.push_back(offset);
+			m_lengths.push_back(length);
+			m_user_data.push_back(user_data);
+		}
+
+		void push(const Token& token)
+		{
+			this->push(token.kind, token.offset, token.length, token.user_data);
+		}
+
+		// Appends tokens lexed from a slice that starts offset_delta bytes
+		// into this buffer's source.
+		void append(const TokenBuffer& tokens, const uint64_t offset_delta)
+		{
+			m_kinds.insert(m_kinds.end(), tokens.m_kinds.begin(), tokens.m_kinds.end());
+			const size_t first = m_offsets.size();
+			m_offsets.insert(m_offsets.end(), tokens.m_offsets.begin(), tokens.m_offsets.end());
+			for (size_t i = first; i < m_offsets.size(); i++)
+			{
+				m_offsets[i] += offset_delta;
+			}
+			m_lengths.insert(m_lengths.end(), tokens.m_lengths.begin(), tokens.m_lengths.end());
+			m_user_data.insert(m_user_data.end(), tokens.m_user_data.begin(), tokens.m_user_data.end());
+		}
+
+		void clear()
+		{
+			m_kinds.clear();
+			m_offsets.clear();
+			m_lengths.clear();
+			m_user_data.clear();
+		}
+
+		size_t size() const
+		{
+			return m_kinds.size();
+		}
+
+		bool empty() const
+		{
+			return m_kinds.empty();
+		}
+
+		ETokenKind getKind(const size_t index) const
+		{
+			return static_cast<ETokenKind>(m_kinds[index]);
+		}
+
+		uint64_t getOffset(const size_t index) const
+		{
+			return m_offsets[index];
+		}
+
+		uint32_t getLength(const size_t index) const
+		{
+			return m_lengths[index];
+		}
+
+		uint32_t getUserData(const size_t index) const
+		{
+			return m_user_data[index];
+		}
+
+		void setUserData(const size_t index, const uint32_t user_data)
+		{
+			m_user_data[index] = user_data;
+		}
+
+		Token getToken(const size_t index) const
+		{
+			return { this->getKind(index), m_offsets[index], m_lengths[index], m_user_data[index] };
+		}
+
+		const uint8_t* getKinds() const
+		{
+			return m_kinds.data();
+		}
+
+		const uint64_t* getOffsets() const
+		{
+			return m_offsets.data();
+		}
+
+		const uint32_t* getLengths() const
+		{
+			return m_lengths.data();
+		}
+
+		const uint32_t* getUserDatas() const
+		{
+			return m_user_data.data();
+		}
+
+	private:
+		std::vector<uint8_t> m_kinds;
+		std::vector<uint64_t> m_offsets;
+		std::vector<uint32_t> m_lengths;
+		std::vector<uint32_t> m_user_data;
+	};
+
+	// Lexes a whole buffer. A span no tree accepts becomes one Unknown token
+	// up to the next terminator, `;` or `}`, so every call makes progress;
+	// a `;` or `}` no tree accepts, because text follows it, is still a
+	// token of its own kind.
+	// Types are not walked through tree_type: the identifier span is hashed
+	// while it is scanned, `const` and the type name are recognised by
+	// findKeyword, and the same hash interns VariableName tokens, whose
+	// user_data is then the symbol id.
+	class Lexer
+	{
+	public:
+		explicit Lexer(const DefinitionTokenStructureDictionaryTrees& trees, SymbolTable* symbols = nullptr) :
+			Lexer(getTokenAutomata(trees).data(), symbols)
+		{
+
+		}
+
+		// automata holds one automaton per tree, in ETokenKind order, e.g.
+		// the ones of a GrammarImage.
+		Lexer(const DefinitionTokenStructureAutomaton* const* automata, SymbolTable* symbols = nullptr) :
+			m_symbols(symbols)
+		{
+			for (uint32_t i = 0; i < token_trees_count; i++)
+			{
+				m_automata[i] = automata[i];
+			}
+
+			// The grammar stays the source of the type flags: ask tree_type
+			// once per keyword instead of once per token.
+			std::string spelling;
+			for (const _priv::KeywordEntry& entry : _priv::keywords)
+			{
+				spelling = "const ";
+				spelling.append(entry.chars, entry.length);
+				uint32_t user_data = 0;
+				const uint32_t length =
+					m_automata[static_cast<uint32_t>(ETokenKind::Type)]->match(spelling.c_str(), user_data);
+				m_type_accepted[static_cast<uint32_t>(entry.keyword)] = length != 0;
+				m_type_user_data[static_cast<uint32_t>(entry.keyword)] = user_data;
+			}
+		}
+
+		// content must be followed by a '\0' sentinel. Returns false if the
+		// text ends inside a block comment.
+		bool tokenize(const char* content, const size_t content_length, TokenBuffer& tokens) const
+		{
+			const char* const content_begin = content;
+			const char* const content_end = content + content_length;
+			while (true)
+			{
+				if (!_priv::skip_trivia(&content, content_end))
+				{
+					return false;
+				}
+				if (content >= content_end)
+				{
+					return true;
+				}
+				tokens.push(this->next(content, content_end, static_cast<uint64_t>(content - content_begin)));
+				content += tokens.getLength(tokens.size() - 1);
+			}
+		}
+
+		Token next(const char* content, const char* content_end, const uint64_t offset) const
+		{
+			uint32_t hash = _priv::symbol_hash_seed;
+			const char* word_end = content;
+			while (word_end < content_end && _priv::is_identifier(*word_end))
+			{
+				hash = _priv::hash_step(hash, *word_end);
+				word_end++;
+			}
+
+			Token type;
+			if (word_end != content && this->matchType(content, word_end, content_end, offset, type))
+			{
+				return type;
+			}
+
+			for (uint32_t i = static_cast<uint32_t>(ETokenKind::Type) + 1; i < token_trees_count; i++)
+			{
+				uint32_t user_data = 0;
+				const uint32_t length = m_automata[i]->match(content, user_data);
+				if (length != 0)
+				{
+					const ETokenKind kind = static_cast<ETokenKind>(i);
+					if (kind == ETokenKind::VariableName && m_symbols != nullptr)
+					{
+						return { kind, offset, length, m_symbols->intern(content, length, hash) };
+					}
+					return { kind, offset, length, user_data };
+				}
+			}
+			if (*content == ';' || *content == '}')
+			{
+				return { *content == ';' ? ETokenKind::Semicolon : ETokenKind::BktFigureClose, offset, 1, 0 };
+			}
+			const char* unknown_end = content + 1;
+			while (unknown_end < content_end && !_priv::ends_unknown(*unknown_end))
+			{
+				unknown_end++;
+			}
+			return { ETokenKind::Unknown, offset, static_cast<uint32_t>(unknown_end - content), 0 };
+		}
+
+	private:
+		// `const`, any number of ' ', a type keyword, then a terminator. As in
+		// tree_type, the spaces may be absent, e.g. "constint".
+		bool matchType(
+			const char* content,
+			const char* word_end,
+			const char* content_end,
+			const uint64_t offset,
+			Token& token
+		) const
+		{
+			constexpr uint32_t const_length = 5;
+			if (static_cast<uint32_t>(word_end - content) < const_length || findKeyword(content, const_length) != EKeyword::Const)
+			{
+				return false;
+			}
+			const char* type_begin = content + const_length;
+			while (type_begin < content_end && *type_begin == ' ')
+			{
+				type_begin++;
+			}
+			const char* type_end = type_begin;
+			while (type_end < content_end && _priv::is_identifier(*type_end))
+			{
+				type_end++;
+			}
+			const EKeyword keyword = findKeyword(type_begin, static_cast<uint32_t>(type_end - type_begin));
+			if (keyword == EKeyword::None || !m_type_accepted[static_cast<uint32_t>(keyword)]
+				|| !_priv::is_terminator(*type_end))
+			{
+				return false;
+			}
+			token = { ETokenKind::Type, offset, static_cast<uint32_t>(type_end - content),
+				m_type_user_data[static_cast<uint32_t>(keyword)] };
+			return true;
+		}
+
+		static constexpr uint32_t keywords_count = static_cast<uint32_t>(EKeyword::Long) + 1;
+
+		const DefinitionTokenStructureAutomaton* m_automata[token_trees_count];
+		SymbolTable* m_symbols;
+		bool m_type_accepted[keywords_count] = {};
+		uint32_t m_type_user_data[keywords_count] = {};
+	};
+
+	// Push chunks, pull tokens. Token offsets are absolute stream offsets.
+	// A token that crosses a chunk boundary keeps one automaton cursor per
+	// tree and resumes where it stopped, so no byte is scanned twice. The
+	// window only retains the bytes of the token that is still undecided.
+	class StreamLexer
+	{
+	public:
+		explicit StreamLexer(const DefinitionTokenStructureDictionaryTrees& trees) :
+			StreamLexer(getTokenAutomata(trees).data())
+		{
+
+		}
+
+		explicit StreamLexer(const DefinitionTokenStructureAutomaton* const* automata)
+		{
+			for (uint32_t i = 0; i < token_trees_count; i++)
+			{
+				m_automata[i] = automata[i];
+			}
+		}
+
+		void push(const char* chunk, const size_t length)
+		{
+			m_window.insert(m_window.end(), chunk, chunk + length);
+			this->run(false);
+		}
+
+		void finish()
+		{
+			this->run(true);
+		}
+
+		bool pull(Token& token)
+		{
+			if (m_tokens.empty())
+			{
+				return false;
+			}
+			token = m_tokens.front();
+			m_tokens.pop_front();
+			return true;
+		}
+
+		uint64_t getOffset() const
+		{
+			return m_window_offset + m_window.size();
+		}
+
+		size_t getWindowLength() const
+		{
+			return m_window.size();
+		}
+
+	private:
+		enum class EState
+		{
+			Space,
+			LineComment,
+			BlockComment,
+			Token,
+			Unknown
+		};
+
+		char at(const uint64_t position) const
+		{
+			return m_window[static_cast<size_t>(position - m_window_offset)];
+		}
+
+		void startToken(const uint64_t offset)
+		{
+			m_token_start = offset;
+			m_alive = 0;
+			for (uint32_t i = 0; i < token_trees_count; i++)
+			{
+				m_cursors[i] = DefinitionTokenStructureAutomaton::Cursor();
+				m_alive |= 1u << i;
+			}
+			m_state = EState::Token;
+		}
+
+		void emit(const ETokenKind kind, const uint64_t end, const uint32_t user_data)
+		{
+			m_tokens.push_back({ kind, m_token_start, static_cast<uint32_t>(end - m_token_start), user_data });
+			m_position = end;
+			m_state = EState::Space;
+		}
+
+		void run(const bool final)
+		{
+			const uint64_t window_end = m_window_offset + m_window.size();
+			while (true)
+			{
+				if (m_state == EState::Space)
+				{
+					while (m_position < window_end && _priv::is_space(this->at(m_position)))
+					{
+						m_position++;
+					}
+					if (m_position == window_end)
+					{
+						break;
+					}
+					// A '/' at the end of the window may still open a comment.
+					if (this->at(m_position) == '/')
+					{
+						if (m_position + 1 == window_end && !final)
+						{
+							break;
+						}
+						if (m_position + 1 < window_end && (this->at(m_position + 1) == '/' || this->at(m_position + 1) == '*'))
+						{
+							m_state = this->at(m_position + 1) == '/' ? EState::LineComment : EState::BlockComment;
+							m_position += 2;
+							continue;
+						}
+					}
+					this->startToken(m_position);
+				}
+				if (m_state == EState::LineComment)
+				{
+					const char* from = m_window.data() + (m_position - m_window_offset);
+					const void* newline = memchr(from, '\n', static_cast<size_t>(window_end - m_position));
+					if (newline == nullptr)
+					{
+						m_position = window_end;
+						break;
+					}
+					m_position += static_cast<uint64_t>(static_cast<const char*>(newline) - from);
+					m_state = EState::Space;
+					continue;
+				}
+				if (m_state == EState::BlockComment)
+				{
+					// Stops on a '*' that is the last byte, so a "*/" split
+					// between two chunks is still seen.
+					while (m_position + 1 < window_end)
+					{
+						const char* from = m_window.data() + (m_position - m_window_offset);
+						const void* star = memchr(from, '*', static_cast<size_t>(window_end - m_position - 1));
+						if (star == nullptr)
+						{
+							m_position = window_end - 1;
+							break;
+						}
+						m_position += static_cast<uint64_t>(static_cast<const char*>(star) - from);
+						if (this->at(m_position + 1) == '/')
+						{
+							m_position += 2;
+							m_state = EState::Space;
+							break;
+						}
+						m_position++;
+					}
+					if (m_state == EState::BlockComment)
+					{
+						if (final)
+						{
+							m_position = window_end;
+						}
+						break;
+					}
+					continue;
+				}
+				if (m_state == EState::Token)
+				{
+					for (uint32_t i = 0; i < token_trees_count; i++)
+					{
+						if ((m_alive & (1u << i)) == 0)
+						{
+							continue;
+						}
+						const uint64_t from = m_token_start + m_cursors[i].offset;
+						bool alive = m_automata[i]->resume(
+							m_cursors[i], m_window.data() + (from - m_window_offset), static_cast<size_t>(window_end - from));
+						if (alive && final)
+						{
+							alive = m_automata[i]->resume(m_cursors[i], "", 1);
+						}
+						if (!alive)
+						{
+							m_alive &= ~(1u << i);
+						}
+					}
+					if (m_alive != 0)
+					{
+						break;
+					}
+					m_state = EState::Unknown;
+					for (uint32_t i = 0; i < token_trees_count; i++)
+					{
+						if (m_automata[i]->isAccepted(m_cursors[i]))
+						{
+							this->emit(static_cast<ETokenKind>(i), m_token_start + m_cursors[i].accept_length,
+								m_automata[i]->getAcceptedUserData(m_cursors[i]));
+							break;
+						}
+					}
+					if (m_state == EState::Unknown)
+					{
+						const char c = this->at(m_token_start);
+						if (c == ';' || c == '}')
+						{
+							this->emit(c == ';' ? ETokenKind::Semicolon : ETokenKind::BktFigureClose, m_token_start + 1, 0);
+							continue;
+						}
+						m_position = m_token_start + 1;
+					}
+				}
+				if (m_state == EState::Unknown)
+				{
+					while (m_position < window_end && !_priv::ends_unknown(this->at(m_position)))
+					{
+						m_position++;
+					}
+					if (m_position == window_end && !final)
+					{
+						break;
+					}
+					this->emit(ETokenKind::Unknown, m_position, 0);
+				}
+			}
+
+			const uint64_t retain = m_state == EState::Token || m_state == EState::Unknown ? m_token_start : m_position;
+			m_window.erase(m_window.begin(), m_window.begin() + static_cast<ptrdiff_t>(retain - m_window_offset));
+			m_window_offset = retain;
+		}
+
+		const DefinitionTokenStructureAutomaton* m_automata[token_trees_count];
+		DefinitionTokenStructureAutomaton::Cursor m_cursors[token_trees_count];
+		uint32_t m_alive = 0;
+		EState m_state = EState::Space;
+		uint64_t m_token_start = 0;
+		uint64_t m_position = 0;
+		std::vector<char> m_window;
+		uint64_t m_window_offset = 0;
+		std::deque<Token> m_tokens;
+	};
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "CharacterSet.h"
+
+
+namespace prs
+{
+	namespace _priv
+	{
+		inline uint32_t __fastcall popcount64(const uint64_t mask)
+		{
+#if defined(_MSC_VER) && defined(_M_X64)
+			return static_cast<uint32_t>(__popcnt64(mask));
+#elif defined(_MSC_VER)
+			return __popcnt(static_cast<uint32_t>(mask)) + __popcnt(static_cast<uint32_t>(mask >> 32));
+#else
+			return static_cast<uint32_t>(__builtin_popcountll(mask));
+#endif
+		}
+	}
+
+	// Both from 1; column counts bytes.
+	struct SourceLocation
+	{
+		uint64_t line;
+		uint64_t column;
+	};
+
+	// The offset where each line starts, found in one pass over the text
+	// 64 bytes at a time. Tokens and diagnostics keep plain byte offsets;
+	// the index is built only when one of them has to be shown to a user,
+	// and a location is then a binary search.
+	class LineIndex
+	{
+	public:
+		void build(const char* content, const size_t content_length)
+		{
+			m_line_starts.assign(1, 0);
+			for (size_t offset = 0; offset < content_length; offset += 64)
+			{
+				const size_t length = content_length - offset < 64 ? content_length - offset : 64;
+				uint64_t newlines;
+				if (length == 64)
+				{
+					newlines = findNewlines(content + offset);
+				}
+				else
+				{
+					alignas(32) char tail[64] = {};
+					memcpy(tail, content + offset, length);
+					newlines = findNewlines(tail);
+				}
+				if (newlines == 0)
+				{
+					continue;
+				}
+				size_t count = m_line_starts.size();
+				m_line_starts.resize(count + _priv::popcount64(newlines));
+				while (newlines != 0)
+				{
+					m_line_starts[count++] = offset + _priv::trailing_zeros64(newlines) + 1;
+					newlines &= newlines - 1;
+				}
+			}
+			m_built = true;
+		}
+
+		void clear()
+		{
+			m_line_starts.clear();
+			m_built = false;
+		}
+
+		bool isBuilt() const
+		{
+			return m_built;
+		}
+
+		size_t getLinesCount() const
+		{
+			return m_line_starts.size();
+		}
+
+		// An offset on a '\n' belongs to the line the '\n' ends.
+		SourceLocation getLocation(const uint64_t offset) const
+		{
+			const auto next = std::upper_bound(m_line_starts.begin(), m_line_starts.end(), offset);
+			const size_t line = static_cast<size_t>(next - m_line_starts.begin());
+			return { line, offset - m_line_starts[line - 1] + 1 };
+		}
+
+	private:
+#if defined(PRS_SIMD_AVX2)
+		static uint64_t findNewlines(const char* chars)
+		{
+			const __m256i newline = _mm256_set1_epi8('\n');
+			const uint32_t low = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(chars)), newline)));
+			const uint32_t high = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(chars + 32)), newline)));
+			return static_cast<uint64_t>(low) | static_cast<uint64_t>(high) << 32;
+		}
+#elif defined(PRS_SIMD_SSSE3)
+		static uint64_t findNewlines(const char* chars)
+		{
+			const __m128i newline = _mm_set1_epi8('\n');
+			uint64_t mask = 0;
+			for (uint32_t quarter = 0; quarter < 4; quarter++)
+			{
+				const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + quarter * 16));
+				mask |= static_cast<uint64_t>(static_cast<uint32_t>(
+					_mm_movemask_epi8(_mm_cmpeq_epi8(input, newline)))) << (quarter * 16);
+			}
+			return mask;
+		}
+#else
+		static uint64_t findNewlines(const char* chars)
+		{
+			uint64_t mask = 0;
+			for (uint32_t i = 0; i < 64; i++)
+			{
+				mask |= static_cast<uint64_t>(chars[i] == '\n') << i;
+			}
+			return mask;
+		}
+#endif
+
+		std::vector<uint64_t> m_line_starts;
+		bool m_built = false;
+	};
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+
+// Define PRS_STATS to count the work the matchers do. Without it the
+// counters are not compiled in at all and every getStats() returns zeros.
+#if defined(PRS_STATS)
+#define PRS_STATS_ONLY(...) __VA_ARGS__
+#else
+#define PRS_STATS_ONLY(...)
+#endif
+
+
+namespace prs
+{
+	struct MatchStats
+	{
+		uint64_t calls = 0;
+		uint64_t nodes_visited = 0;
+		uint64_t max_depth = 0;
+		uint64_t backtracks = 0;
+		uint64_t bytes_reexamined = 0;
+		uint64_t matches = 0;
+		uint64_t length_calls = 0;
+
+		MatchStats& operator += (const MatchStats& stats)
+		{
+			calls += stats.calls;
+			nodes_visited += stats.nodes_visited;
+			max_depth = max_depth > stats.max_depth ? max_depth : stats.max_depth;
+			backtracks += stats.backtracks;
+			bytes_reexamined += stats.bytes_reexamined;
+			matches += stats.matches;
+			length_calls += stats.length_calls;
+			return *this;
+		}
+	};
+
+	// State of one trie walk: how deep it is and how far into the input
+	// any branch has read so far.
+	struct MatchTrace
+	{
+		const char* examined_end;
+		uint64_t depth;
+	};
+
+	// Live counters of one tree, shared by its trie walk, its automaton and
+	// the getLength of its patterns. Relaxed atomics, so the counts stay
+	// exact when several lexers share the grammar.
+	class MatchCounters
+	{
+	public:
+		void add(std::atomic<uint64_t>& counter, const uint64_t value)
+		{
+			counter.fetch_add(value, std::memory_order_relaxed);
+		}
+
+		void depth(const uint64_t value)
+		{
+			uint64_t current = max_depth.load(std::memory_order_relaxed);
+			while (current < value && !max_depth.compare_exchange_weak(current, value, std::memory_order_relaxed))
+			{
+
+			}
+		}
+
+		MatchStats snapshot() const
+		{
+			MatchStats stats;
+			stats.calls = calls.load(std::memory_order_relaxed);
+			stats.nodes_visited = nodes_visited.load(std::memory_order_relaxed);
+			stats.max_depth = max_depth.load(std::memory_order_relaxed);
+			stats.backtracks = backtracks.load(std::memory_order_relaxed);
+			stats.bytes_reexamined = bytes_reexamined.load(std::memory_order_relaxed);
+			stats.matches = matches.load(std::memory_order_relaxed);
+			stats.length_calls = length_calls.load(std::memory_order_relaxed);
+			return stats;
+		}
+
+		void reset()
+		{
+			calls = 0;
+			nodes_visited = 0;
+			max_depth = 0;
+			backtracks = 0;
+			bytes_reexamined = 0;
+			matches = 0;
+			length_calls = 0;
+		}
+
+		std::atomic<uint64_t> calls{ 0 };
+		std::atomic<uint64_t> nodes_visited{ 0 };
+		std::atomic<uint64_t> max_depth{ 0 };
+		std::atomic<uint64_t> backtracks{ 0 };
+		std::atomic<uint64_t> bytes_reexamined{ 0 };
+		std::atomic<uint64_t> matches{ 0 };
+		std::atomic<uint64_t> length_calls{ 0 };
+	};
+}
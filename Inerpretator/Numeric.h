@@ -0,0 +1,509 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <charconv>
+#include <string>
+#include "deftok.h"
+#include "PowersOfFive.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace prs
+{
+	struct NumericValue
+	{
+		ENumericTypeTraits type;
+		union
+		{
+			int32_t s_int;
+			int64_t s_long;
+			float f;
+			double d;
+		};
+	};
+
+	namespace _priv
+	{
+		struct Value128
+		{
+			uint64_t low;
+			uint64_t high;
+		};
+
+		inline Value128 __fastcall full_multiplication(const uint64_t a, const uint64_t b)
+		{
+#if defined(__SIZEOF_INT128__)
+			const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+			return { static_cast<uint64_t>(product), static_cast<uint64_t>(product >> 64) };
+#elif defined(_M_X64)
+			Value128 product;
+			product.low = _umul128(a, b, &product.high);
+			return product;
+#else
+			const uint64_t a_low = a & 0xFFFFFFFF;
+			const uint64_t a_high = a >> 32;
+			const uint64_t b_low = b & 0xFFFFFFFF;
+			const uint64_t b_high = b >> 32;
+			const uint64_t low_low = a_low * b_low;
+			const uint64_t high_low = a_high * b_low;
+			const uint64_t low_high = a_low * b_high;
+			const uint64_t middle = (low_low >> 32) + (high_low & 0xFFFFFFFF) + low_high;
+			return { (middle << 32) | (low_low & 0xFFFFFFFF), a_high * b_high + (high_low >> 32) + (middle >> 32) };
+#endif
+		}
+
+		inline int32_t __fastcall leading_zeros(const uint64_t value)
+		{
+#if defined(_MSC_VER) && defined(_M_X64)
+			unsigned long index = 0;
+			_BitScanReverse64(&index, value);
+			return 63 - static_cast<int32_t>(index);
+#elif defined(_MSC_VER)
+			unsigned long index = 0;
+			if (_BitScanReverse(&index, static_cast<uint32_t>(value >> 32)))
+			{
+				return 31 - static_cast<int32_t>(index);
+			}
+			_BitScanReverse(&index, static_cast<uint32_t>(value));
+			return 63 - static_cast<int32_t>(index);
+#else
+			return __builtin_clzll(value);
+#endif
+		}
+
+		inline bool __fastcall is_digit(const char c)
+		{
+			return static_cast<uint8_t>(c - '0') < 10;
+		}
+
+		// SWAR: eight ASCII digits at once, little-endian load.
+		inline bool __fastcall is_eight_digits(const char* chars)
+		{
+			uint64_t value;
+			memcpy(&value, chars, sizeof(value));
+			return (((value & 0xF0F0F0F0F0F0F0F0) |
+				(((value + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333);
+		}
+
+		inline uint32_t __fastcall parse_eight_digits(const char* chars)
+		{
+			uint64_t value;
+			memcpy(&value, chars, sizeof(value));
+			value = (value & 0x0F0F0F0F0F0F0F0F) * 2561 >> 8;
+			value = (value & 0x00FF00FF00FF00FF) * 6553601 >> 16;
+			return static_cast<uint32_t>((value & 0x0000FFFF0000FFFF) * 42949672960001 >> 32);
+		}
+
+		// Decimal span: mantissa holds up to 19 significant digits and the
+		// value is mantissa * 10^exponent. truncated marks dropped digits.
+		struct DecimalNumber
+		{
+			uint64_t mantissa;
+			int64_t exponent;
+			bool negative;
+			bool truncated;
+		};
+
+		inline const char* __fastcall parse_digits(const char* chars, const char* chars_end, uint64_t& mantissa)
+		{
+			while (chars_end - chars >= 8 && is_eight_digits(chars))
+			{
+				mantissa = mantissa * 100000000 + parse_eight_digits(chars);
+				chars += 8;
+			}
+			while (chars < chars_end && is_digit(*chars))
+			{
+				mantissa = mantissa * 10 + static_cast<uint64_t>(*chars - '0');
+				chars++;
+			}
+			return chars;
+		}
+
+		inline bool __fastcall parse_decimal(const char* chars, const uint32_t length, DecimalNumber& number)
+		{
+			const char* const chars_end = chars + length;
+			number = { 0, 0, false, false };
+			if (chars < chars_end && (*chars == '+' || *chars == '-'))
+			{
+				number.negative = *chars == '-';
+				chars++;
+			}
+			const char* const integer_begin = chars;
+			chars = parse_digits(chars, chars_end, number.mantissa);
+			const char* const integer_end = chars;
+			const char* fraction_begin = chars;
+			const char* fraction_end = chars;
+			if (chars < chars_end && *chars == '.')
+			{
+				fraction_begin = chars + 1;
+				fraction_end = parse_digits(fraction_begin, chars_end, number.mantissa);
+				chars = fraction_end;
+				number.exponent = -(fraction_end - fraction_begin);
+			}
+			if (integer_begin == integer_end && fraction_begin == fraction_end)
+			{
+				return false;
+			}
+
+			int64_t digits_count = (integer_end - integer_begin) + (fraction_end - fraction_begin);
+			if (digits_count > 19)
+			{
+				// Leading zeros are not significant; reparse the first 19
+				// significant digits only when there really are more.
+				const char* start = integer_begin;
+				while (start < fraction_end && (*start == '0' || *start == '.'))
+				{
+					if (*start == '0')
+					{
+						digits_count--;
+					}
+					start++;
+				}
+				if (digits_count > 19)
+				{
+					number.truncated = true;
+					number.mantissa = 0;
+					const char* cursor = integer_begin;
+					int64_t taken = 0;
+					while (cursor < integer_end && number.mantissa < 1000000000000000000ULL)
+					{
+						number.mantissa = number.mantissa * 10 + static_cast<uint64_t>(*cursor++ - '0');
+					}
+					if (number.mantissa >= 1000000000000000000ULL)
+					{
+						number.exponent = integer_end - cursor;
+					}
+					else
+					{
+						cursor = fraction_begin;
+						while (cursor < fraction_end && number.mantissa < 1000000000000000000ULL)
+						{
+							number.mantissa = number.mantissa * 10 + static_cast<uint64_t>(*cursor++ - '0');
+							taken++;
+						}
+						number.exponent = -taken;
+					}
+				}
+			}
+			return true;
+		}
+
+		template <typename _Float>
+		struct BinaryFormat;
+
+		template <>
+		struct BinaryFormat<double>
+		{
+			using word_type = uint64_t;
+			static constexpr int32_t mantissa_explicit_bits = 52;
+			static constexpr int32_t minimum_exponent = -1023;
+			static constexpr int32_t infinite_power = 0x7FF;
+			static constexpr int32_t sign_index = 63;
+			static constexpr int64_t smallest_power_of_ten = -342;
+			static constexpr int64_t largest_power_of_ten = 308;
+			static constexpr int64_t min_exponent_round_to_even = -4;
+			static constexpr int64_t max_exponent_round_to_even = 23;
+			static constexpr int64_t min_exponent_fast_path = -22;
+			static constexpr int64_t max_exponent_fast_path = 22;
+			static constexpr uint64_t max_mantissa_fast_path = uint64_t(2) << 52;
+		};
+
+		template <>
+		struct BinaryFormat<float>
+		{
+			using word_type = uint32_t;
+			static constexpr int32_t mantissa_explicit_bits = 23;
+			static constexpr int32_t minimum_exponent = -127;
+			static constexpr int32_t infinite_power = 0xFF;
+			static constexpr int32_t sign_index = 31;
+			static constexpr int64_t smallest_power_of_ten = -65;
+			static constexpr int64_t largest_power_of_ten = 38;
+			static constexpr int64_t min_exponent_round_to_even = -17;
+			static constexpr int64_t max_exponent_round_to_even = 10;
+			static constexpr int64_t min_exponent_fast_path = -10;
+			static constexpr int64_t max_exponent_fast_path = 10;
+			static constexpr uint64_t max_mantissa_fast_path = uint64_t(2) << 23;
+		};
+
+		template <typename _Float>
+		inline _Float __fastcall exact_power_of_ten(const int64_t power)
+		{
+			static const _Float powers[] = {
+				_Float(1e0), _Float(1e1), _Float(1e2), _Float(1e3), _Float(1e4), _Float(1e5),
+				_Float(1e6), _Float(1e7), _Float(1e8), _Float(1e9), _Float(1e10), _Float(1e11),
+				_Float(1e12), _Float(1e13), _Float(1e14), _Float(1e15), _Float(1e16), _Float(1e17),
+				_Float(1e18), _Float(1e19), _Float(1e20), _Float(1e21), _Float(1e22)
+			};
+			return powers[power];
+		}
+
+		struct AdjustedMantissa
+		{
+			uint64_t mantissa;
+			int32_t power2;
+		};
+
+		// Eisel-Lemire: multiply the normalised decimal mantissa by the
+		// truncated 128-bit power of five and round; exact for every
+		// mantissa that was not truncated.
+		template <typename _Float>
+		inline AdjustedMantissa __fastcall compute_float(const int64_t q, uint64_t w)
+		{
+			using format = BinaryFormat<_Float>;
+			if (w == 0 || q < format::smallest_power_of_ten)
+			{
+				return { 0, 0 };
+			}
+			if (q > format::largest_power_of_ten)
+			{
+				return { 0, format::infinite_power };
+			}
+			const int32_t lz = leading_zeros(w);
+			w <<= lz;
+
+			const uint64_t* powers = power_of_five_128();
+			const size_t index = 2 * static_cast<size_t>(q - smallest_power_of_five);
+			constexpr uint64_t precision_mask = 0xFFFFFFFFFFFFFFFFULL >> (format::mantissa_explicit_bits + 3);
+			Value128 product = full_multiplication(w, powers[index]);
+			if ((product.high & precision_mask) == precision_mask)
+			{
+				const Value128 second = full_multiplication(w, powers[index + 1]);
+				product.low += second.high;
+				if (second.high > product.low)
+				{
+					product.high++;
+				}
+			}
+
+			AdjustedMantissa answer;
+			const int32_t upper_bit = static_cast<int32_t>(product.high >> 63);
+			const int32_t shift = upper_bit + 64 - format::mantissa_explicit_bits - 3;
+			answer.mantissa = product.high >> shift;
+			answer.power2 = static_cast<int32_t>((((152170 + 65536) * q) >> 16) + 63 + upper_bit - lz - format::minimum_exponent);
+			if (answer.power2 <= 0)
+			{
+				if (-answer.power2 + 1 >= 64)
+				{
+					return { 0, 0 };
+				}
+				answer.mantissa >>= -answer.power2 + 1;
+				answer.mantissa += (answer.mantissa & 1);
+				answer.mantissa >>= 1;
+				answer.power2 = (answer.mantissa < (uint64_t(1) << format::mantissa_explicit_bits)) ? 0 : 1;
+				return answer;
+			}
+			if (product.low <= 1 && q >= format::min_exponent_round_to_even &&
+				q <= format::max_exponent_round_to_even && (answer.mantissa & 3) == 1)
+			{
+				if ((answer.mantissa << shift) == product.high)
+				{
+					answer.mantissa &= ~uint64_t(1);
+				}
+			}
+			answer.mantissa += (answer.mantissa & 1);
+			answer.mantissa >>= 1;
+			if (answer.mantissa >= (uint64_t(2) << format::mantissa_explicit_bits))
+			{
+				answer.mantissa = uint64_t(1) << format::mantissa_explicit_bits;
+				answer.power2++;
+			}
+			answer.mantissa &= ~(uint64_t(1) << format::mantissa_explicit_bits);
+			if (answer.power2 >= format::infinite_power)
+			{
+				return { 0, format::infinite_power };
+			}
+			return answer;
+		}
+
+		template <typename _Float>
+		inline _Float __fastcall to_float(const AdjustedMantissa& am, const bool negative)
+		{
+			using format = BinaryFormat<_Float>;
+			typename format::word_type word = static_cast<typename format::word_type>(am.mantissa);
+			word |= static_cast<typename format::word_type>(am.power2) << format::mantissa_explicit_bits;
+			word |= static_cast<typename format::word_type>(negative ? 1 : 0) << format::sign_index;
+			_Float value;
+			memcpy(&value, &word, sizeof(value));
+			return value;
+		}
+
+		template <typename _Float>
+		inline bool __fastcall parse_float(const char* chars, const uint32_t length, _Float& value)
+		{
+			using format = BinaryFormat<_Float>;
+			DecimalNumber number;
+			if (!parse_decimal(chars, length, number))
+			{
+				return false;
+			}
+			if (!number.truncated && number.mantissa <= format::max_mantissa_fast_path &&
+				number.exponent >= format::min_exponent_fast_path && number.exponent <= format::max_exponent_fast_path)
+			{
+				// Clinger: both operands are exact, so one IEEE operation rounds correctly.
+				value = static_cast<_Float>(number.mantissa);
+				value = number.exponent < 0
+					? value / exact_power_of_ten<_Float>(-number.exponent)
+					: value * exact_power_of_ten<_Float>(number.exponent);
+				value = number.negative ? -value : value;
+				return true;
+			}
+			AdjustedMantissa am = compute_float<_Float>(number.exponent, number.mantissa);
+			if (number.truncated && number.mantissa != 0)
+			{
+				const AdjustedMantissa upper = compute_float<_Float>(number.exponent, number.mantissa + 1);
+				if (upper.mantissa != am.mantissa || upper.power2 != am.power2)
+				{
+					// The dropped digits decide the rounding: take the slow,
+					// exact path on the digits without sign and suffix.
+					const char* begin = chars + ((*chars == '+' || *chars == '-') ? 1 : 0);
+					const char* end = chars + length;
+					while (end > begin && !is_digit(end[-1]) && end[-1] != '.')
+					{
+						end--;
+					}
+					std::string digits(begin, end);
+					if (!digits.empty() && digits.back() == '.')
+					{
+						digits.push_back('0');
+					}
+					if (!digits.empty() && digits.front() == '.')
+					{
+						digits.insert(digits.begin(), '0');
+					}
+					const std::from_chars_result result = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+					if (result.ec == std::errc::result_out_of_range)
+					{
+						// value is left as it was; the estimate tells which
+						// way the digits fell out, as strtod would.
+						value = am.power2 > format::infinite_power / 2
+							? std::numeric_limits<_Float>::infinity() : _Float(0);
+					}
+					else if (result.ec != std::errc())
+					{
+						return false;
+					}
+					value = number.negative ? -value : value;
+					return true;
+				}
+			}
+			value = to_float<_Float>(am, number.negative);
+			return true;
+		}
+	}
+
+	namespace _priv
+	{
+		// The magnitude is checked against the most negative value before each
+		// step could overflow it, and once more for the sign at the end.
+		template <typename _Int>
+		inline bool __fastcall parse_integer(const char* chars, const uint32_t length, _Int& value)
+		{
+			constexpr uint64_t limit = static_cast<uint64_t>(std::numeric_limits<_Int>::max()) + 1;
+			const char* const chars_end = chars + length;
+			bool negative = false;
+			if (chars < chars_end && (*chars == '+' || *chars == '-'))
+			{
+				negative = *chars == '-';
+				chars++;
+			}
+			if (chars == chars_end)
+			{
+				return false;
+			}
+			uint64_t magnitude = 0;
+			while (chars_end - chars >= 8 && is_eight_digits(chars))
+			{
+				if (magnitude > limit / 100000000)
+				{
+					return false;
+				}
+				magnitude = magnitude * 100000000 + parse_eight_digits(chars);
+				chars += 8;
+				if (magnitude > limit)
+				{
+					return false;
+				}
+			}
+			for (; chars < chars_end; chars++)
+			{
+				if (!is_digit(*chars) || magnitude > limit / 10)
+				{
+					return false;
+				}
+				magnitude = magnitude * 10 + static_cast<uint64_t>(*chars - '0');
+				if (magnitude > limit)
+				{
+					return false;
+				}
+			}
+			if (magnitude > (negative ? limit : limit - 1))
+			{
+				return false;
+			}
+			value = negative
+				? static_cast<_Int>(0 - magnitude)
+				: static_cast<_Int>(magnitude);
+			return true;
+		}
+	}
+
+	inline bool __fastcall parseSInt(const char* chars, const uint32_t length, int32_t& value)
+	{
+		return _priv::parse_integer<int32_t>(chars, length, value);
+	}
+
+	inline bool __fastcall parseSLong(const char* chars, const uint32_t length, int64_t& value)
+	{
+		return _priv::parse_integer<int64_t>(chars, length, value);
+	}
+
+	inline bool __fastcall parseFloat(const char* chars, const uint32_t length, float& value)
+	{
+		return _priv::parse_float<float>(chars, length, value);
+	}
+
+	inline bool __fastcall parseDouble(const char* chars, const uint32_t length, double& value)
+	{
+		return _priv::parse_float<double>(chars, length, value);
+	}
+
+	// Converts a span matched by tree_numeric according to the type flag
+	// the pattern carries in its user_data. The f/F/d/D suffix is part of
+	// the span and simply ends the digits. An integer literal is read as
+	// integer_type, SInt or SLong.
+	inline bool __fastcall convertNumeric(
+		const char* chars,
+		const uint32_t length,
+		const uint32_t user_data,
+		NumericValue& value,
+		const ENumericTypeTraits integer_type = ENumericTypeTraits::SInt
+	)
+	{
+		constexpr uint32_t type_mask = 0xF0000000;
+		if (comp_flag(user_data, type_mask, ENumericTypeTraits::Float))
+		{
+			value.type = ENumericTypeTraits::Float;
+			return parseFloat(chars, length, value.f);
+		}
+		if (comp_flag(user_data, type_mask, ENumericTypeTraits::Double))
+		{
+			value.type = ENumericTypeTraits::Double;
+			return parseDouble(chars, length, value.d);
+		}
+		if (comp_flag(user_data, type_mask, ENumericTypeTraits::SInt))
+		{
+			if (integer_type == ENumericTypeTraits::SLong)
+			{
+				value.type = ENumericTypeTraits::SLong;
+				return parseSLong(chars, length, value.s_long);
+			}
+			value.type = ENumericTypeTraits::SInt;
+			return parseSInt(chars, length, value.s_int);
+		}
+		return false;
+	}
+}
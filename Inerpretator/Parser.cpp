@@ -1,3 +1,358 @@
+#include <chrono>
 #include "Parser.h"
+#include "Lexer.h"
 
 
+namespace prs
+{
+	TokenBuffer Parser::fromMemory(const char* content, const size_t content_length)
+	{
+		PRS_STATS_ONLY(const ParserStats before = this->snapshotStats();)
+		TokenBuffer tokens;
+		tokens.reserveForInput(content_length);
+		m_symbols.clear();
+		Lexer(m_grammar->getAutomata().data(), &m_symbols).tokenize(content, content_length, tokens);
+
+		PRS_STATS_ONLY(this->collectStats(before);)
+
+		m_declarations.clear();
+		m_diagnostics.clear();
+		findDeclarations(m_grammar->getStatements(), tokens, content_length, m_declarations, m_diagnostics);
+		return tokens;
+	}
+
+	TokenBuffer Parser::fromMemory(const char* content, const size_t content_length, ThreadPool& pool)
+	{
+		const size_t chunk_size = std::max(parallel_min_chunk_size, content_length / (pool.getThreadsCount() * 4) + 1);
+		std::vector<size_t> splits(1, 0);
+		while (splits.back() + chunk_size < content_length)
+		{
+			const size_t split = findSplit(content, splits.back(), splits.back() + chunk_size, content_length);
+			if (split >= content_length)
+			{
+				break;
+			}
+			splits.push_back(split);
+		}
+		splits.push_back(content_length);
+		const size_t chunks_count = splits.size() - 1;
+		if (chunks_count == 1)
+		{
+			return this->fromMemory(content, content_length);
+		}
+
+		struct Chunk
+		{
+			TokenBuffer tokens;
+			std::vector<size_t> declarations;
+			std::vector<Diagnostic> diagnostics;
+			SymbolTable symbols;
+			bool closed = true;
+		};
+
+		PRS_STATS_ONLY(const ParserStats before = this->snapshotStats();)
+		std::vector<Chunk> chunks(chunks_count);
+		pool.parallelFor(chunks_count, [&](const size_t index, const size_t)
+		{
+			Chunk& chunk = chunks[index];
+			const size_t length = splits[index + 1] - splits[index];
+			chunk.tokens.reserveForInput(length);
+			chunk.closed = Lexer(m_grammar->getAutomata().data(), &chunk.symbols).tokenize(
+				content + splits[index], length, chunk.tokens);
+			findDeclarations(m_grammar->getStatements(), chunk.tokens, length, chunk.declarations, chunk.diagnostics);
+		});
+
+		PRS_STATS_ONLY(this->collectStats(before);)
+
+		// findSplit sees line comments but not block comments: a chunk
+		// that ends inside one was cut at a `;` that is comment text.
+		for (size_t i = 0; i + 1 < chunks_count; i++)
+		{
+			if (!chunks[i].closed)
+			{
+				return this->fromMemory(content, content_length);
+			}
+		}
+
+		// Stitch in source order. Offsets are shifted by the chunk start,
+		// declaration indices by the tokens before the chunk, and symbol ids
+		// are re-interned so they match what a serial pass would give.
+		size_t tokens_count = 0;
+		for (const Chunk& chunk : chunks)
+		{
+			tokens_count += chunk.tokens.size();
+		}
+		TokenBuffer tokens;
+		tokens.reserve(tokens_count);
+		m_declarations.clear();
+		m_diagnostics.clear();
+		m_symbols.clear();
+		std::vector<uint32_t> symbols;
+		for (size_t i = 0; i < chunks_count; i++)
+		{
+			Chunk& chunk = chunks[i];
+			symbols.resize(chunk.symbols.getSymbolsCount());
+			for (uint32_t symbol = 0; symbol < chunk.symbols.getSymbolsCount(); symbol++)
+			{
+				symbols[symbol] = m_symbols.intern(chunk.symbols.getChars(symbol), chunk.symbols.getLength(symbol));
+			}
+			for (size_t index = 0; index < chunk.tokens.size(); index++)
+			{
+				if (chunk.tokens.getKind(index) == ETokenKind::VariableName)
+				{
+					chunk.tokens.setUserData(index, symbols[chunk.tokens.getUserData(index)]);
+				}
+			}
+			for (const size_t declaration : chunk.declarations)
+			{
+				m_declarations.push_back(tokens.size() + declaration);
+			}
+			for (Diagnostic diagnostic : chunk.diagnostics)
+			{
+				diagnostic.offset += splits[i];
+				m_diagnostics.push_back(diagnostic);
+			}
+			tokens.append(chunk.tokens, splits[i]);
+		}
+		return tokens;
+	}
+
+	std::vector<ParseResult> Parser::fromFiles(const std::vector<std::string>& file_paths, ThreadPool& pool)
+	{
+		PRS_STATS_ONLY(const ParserStats before = this->snapshotStats();)
+		const auto begin = std::chrono::steady_clock::now();
+		std::vector<ParseResult> results(file_paths.size());
+		std::vector<uint64_t> lengths(file_paths.size(), 0);
+		pool.parallelFor(file_paths.size(), [&](const size_t index, const size_t)
+		{
+			SourceBuffer source;
+			if (source.mapFile(file_paths[index]))
+			{
+				this->parse(source.getData(), source.getLength(), results[index]);
+				lengths[index] = source.getLength();
+			}
+		});
+
+		m_batch_stats.inputs_count = file_paths.size();
+		m_batch_stats.bytes_count = 0;
+		for (const uint64_t length : lengths)
+		{
+			m_batch_stats.bytes_count += length;
+		}
+		m_batch_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		PRS_STATS_ONLY(this->collectStats(before);)
+		return results;
+	}
+
+	std::vector<ParseResult> Parser::fromMemory(const std::vector<MemoryInput>& inputs, ThreadPool& pool)
+	{
+		PRS_STATS_ONLY(const ParserStats before = this->snapshotStats();)
+		const auto begin = std::chrono::steady_clock::now();
+		std::vector<ParseResult> results(inputs.size());
+		std::vector<std::vector<char>> scratch(pool.getThreadsCount());
+		pool.parallelFor(inputs.size(), [&](const size_t index, const size_t worker)
+		{
+			const MemoryInput& input = inputs[index];
+			std::vector<char>& buffer = scratch[worker];
+			buffer.assign(input.content, input.content + input.length);
+			buffer.resize(input.length + SourceBuffer::padding, '\0');
+			this->parse(buffer.data(), input.length, results[index]);
+		});
+
+		m_batch_stats.inputs_count = inputs.size();
+		m_batch_stats.bytes_count = 0;
+		for (const MemoryInput& input : inputs)
+		{
+			m_batch_stats.bytes_count += input.length;
+		}
+		m_batch_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		PRS_STATS_ONLY(this->collectStats(before);)
+		return results;
+	}
+
+	// Touches nothing of the parser but the shared grammar, so batch tasks
+	// may run it concurrently.
+	void Parser::parse(const char* content, const size_t content_length, ParseResult& result) const
+	{
+		result.loaded = true;
+		result.tokens.reserveForInput(content_length);
+		Lexer(m_grammar->getAutomata().data(), &result.symbols).tokenize(content, content_length, result.tokens);
+		findDeclarations(m_grammar->getStatements(), result.tokens, content_length, result.declarations, result.diagnostics);
+		if (!result.diagnostics.empty())
+		{
+			result.lines.build(content, content_length);
+		}
+	}
+
+	void Parser::findDeclarations(
+		const StatementTable& statements,
+		const TokenBuffer& tokens,
+		const size_t content_length,
+		std::vector<size_t>& declarations,
+		std::vector<Diagnostic>& diagnostics
+	)
+	{
+		StatementRecognizer recognizer(statements);
+		for (size_t index = 0; index < tokens.size(); index++)
+		{
+			if (recognizer.push(tokens.getKind(index), tokens.getOffset(index), diagnostics) &&
+				recognizer.getUserData() == static_cast<uint32_t>(EStatement::Declaration))
+			{
+				declarations.push_back(recognizer.getStatement());
+			}
+		}
+		recognizer.finish(content_length, diagnostics);
+	}
+
+	// A `;` or `}` with whitespace on both sides is a token of its own. No
+	// token but `const int`-style types holds whitespace, so lexing may
+	// restart after it, and StatementRecognizer is always between
+	// statements there, so the chunks parse as they would in one pass.
+	// A `;` after `//` on its line is comment text; the search goes on
+	// after the newline. No line comment runs over previous, the split
+	// before, so the look back stops there.
+	size_t Parser::findSplit(const char* content, const size_t previous, const size_t from, const size_t content_length)
+	{
+		static const CharacterSet others = []()
+		{
+			CharacterSet set;
+			for (uint32_t c = 1; c < 256; c++)
+			{
+				if (c != ';' && c != '}')
+				{
+					set.add(static_cast<char>(c));
+				}
+			}
+			return set;
+		}();
+
+		size_t position = from;
+		while (position < content_length)
+		{
+			position += others.span(content + position);
+			if (position >= content_length)
+			{
+				break;
+			}
+			if (content[position] != '\0' && position > 0
+				&& _priv::is_space(content[position - 1]) && _priv::is_space(content[position + 1]))
+			{
+				size_t line = position;
+				while (line > previous + 1 && content[line - 1] != '\n'
+					&& !(content[line - 1] == '/' && content[line - 2] == '/'))
+				{
+					line--;
+				}
+				if (line <= previous + 1 || content[line - 1] == '\n')
+				{
+					return position + 1;
+				}
+				const void* newline = memchr(content + position, '\n', content_length - position);
+				if (newline == nullptr)
+				{
+					break;
+				}
+				position = static_cast<size_t>(static_cast<const char*>(newline) - content);
+			}
+			position++;
+		}
+		return content_length;
+	}
+
+	void Parser::fromStream(std::istream& stream)
+	{
+		PRS_STATS_ONLY(const ParserStats before = this->snapshotStats();)
+		StreamLexer lexer(m_grammar->getAutomata().data());
+		std::vector<char> window(stream_window_size);
+		StatementRecognizer recognizer(m_grammar->getStatements());
+		m_declarations.clear();
+		m_diagnostics.clear();
+
+		auto consume = [&]()
+		{
+			Token token;
+			while (lexer.pull(token))
+			{
+				if (recognizer.push(token.kind, token.offset, m_diagnostics) &&
+					recognizer.getUserData() == static_cast<uint32_t>(EStatement::Declaration))
+				{
+					m_declarations.push_back(recognizer.getStatement());
+				}
+			}
+		};
+
+		while (stream)
+		{
+			stream.read(window.data(), static_cast<std::streamsize>(window.size()));
+			const size_t length = static_cast<size_t>(stream.gcount());
+			if (length == 0)
+			{
+				break;
+			}
+			lexer.push(window.data(), length);
+			consume();
+		}
+		lexer.finish();
+		consume();
+		recognizer.finish(lexer.getOffset(), m_diagnostics);
+		PRS_STATS_ONLY(this->collectStats(before);)
+	}
+
+	ParserStats Parser::snapshotStats() const
+	{
+		ParserStats stats;
+		for (uint32_t i = 0; i < token_trees_count; i++)
+		{
+			stats.trees[i] = m_grammar->getStats(static_cast<ETokenKind>(i));
+		}
+		return stats;
+	}
+
+	// The grammar counts for its whole lifetime: add what grew since before.
+	void Parser::collectStats(const ParserStats& before)
+	{
+		const ParserStats after = this->snapshotStats();
+		for (uint32_t i = 0; i < token_trees_count; i++)
+		{
+			MatchStats& stats = m_stats.trees[i];
+			const MatchStats& from = before.trees[i];
+			const MatchStats& to = after.trees[i];
+			stats.calls += to.calls - from.calls;
+			stats.nodes_visited += to.nodes_visited - from.nodes_visited;
+			stats.max_depth = std::max(stats.max_depth, to.max_depth);
+			stats.backtracks += to.backtracks - from.backtracks;
+			stats.bytes_reexamined += to.bytes_reexamined - from.bytes_reexamined;
+			stats.matches += to.matches - from.matches;
+			stats.length_calls += to.length_calls - from.length_calls;
+		}
+	}
+
+	void Parser::dumpStats(std::ostream& stream) const
+	{
+		static const char* const names[token_trees_count] = {
+			"tree_type",
+			"tree_numeric",
+			"tree_assignment",
+			"tree_semicolon",
+			"tree_bkt_figure_open",
+			"tree_bkt_figure_close",
+			"tree_variable_name"
+		};
+
+		stream << "{\n\t\"trees\": {";
+		for (uint32_t i = 0; i < token_trees_count; i++)
+		{
+			const MatchStats& stats = m_stats.trees[i];
+			stream << (i == 0 ? "\n" : ",\n")
+				<< "\t\t\"" << names[i] << "\": {"
+				<< "\"calls\": " << stats.calls
+				<< ", \"nodes_visited\": " << stats.nodes_visited
+				<< ", \"max_depth\": " << stats.max_depth
+				<< ", \"backtracks\": " << stats.backtracks
+				<< ", \"bytes_reexamined\": " << stats.bytes_reexamined
+				<< ", \"matches\": " << stats.matches
+				<< ", \"length_calls\": " << stats.length_calls << "}";
+		}
+		stream << "\n\t}\n}\n";
+	}
+}
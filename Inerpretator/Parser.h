@@ -1,910 +1,312 @@
 #pragma once
-#include <map>
 #include <string>
-#include <fstream>
-#include <list>
-#include <xmemory>
-#include <iostream>
-#include <vector>
-#include <type_traits>
+#include <istream>
+#include <ostream>
+#include "Lexer.h"
+#include "Grammar.h"
+#include "SourceBuffer.h"
+#include "ThreadPool.h"
 
 
 namespace prs
 {
-	namespace _priv
+	enum class EDiagnostic
 	{
-		inline void __fastcall skip_space(const char** ptr_content)
-		{
-			while (**ptr_content == ' ' || **ptr_content == '\n' || **ptr_content == '\t')
-			{
-				(*ptr_content)++;
-			}
-		}
-	}
-
-	template <typename _FlagU32>
-	inline constexpr const uint32_t __fastcall make_flag(_FlagU32 flag)
-	{
-		static_assert(
-			std::is_arithmetic_v<_FlagU32> || std::is_enum_v<_FlagU32>, 
-			"_FlagU32 is not arithmetic type;"
-			"_FlagU32 is not enum type;"
-			);
-		return static_cast<uint32_t>(flag);
-	}
-
-	template <typename _FlagU32, typename... _FlagsU32>
-	inline constexpr const uint32_t __fastcall make_flag(_FlagU32 flag, _FlagsU32... flags)
-	{
-		static_assert(
-			std::is_arithmetic_v<_FlagU32> || std::is_enum_v<_FlagU32>,
-			"_FlagU32 is not arithmetic type;"
-			"_FlagU32 is not enum type;"
-			);
-		return static_cast<uint32_t>(flag) | make_flag<_FlagsU32...>(flags...);
-	}
-
-	template <typename _CompU32, typename _FlagU32>
-	inline constexpr const bool __fastcall comp_flag(
-		_CompU32 comp, 
-		uint32_t ignore_mask, 
-		_FlagU32 flag
-	)
-	{
-		static_assert(
-			(std::is_arithmetic_v<_FlagU32> || std::is_enum_v<_FlagU32>) &&
-			(std::is_arithmetic_v<_CompU32> || std::is_enum_v<_CompU32>),
-			"_FlagU32 is not arithmetic type;"
-			"_FlagU32 is not enum type;"
-			"_CompU32 is not arithmetic type;"
-			"_CompU32 is not enum type;"
-			);
-		return ((static_cast<uint32_t>(comp) & ignore_mask) == (static_cast<uint32_t>(flag)));
-	}
-
-	template <typename _CompU32, typename _FlagU32, typename... _FlagsU32>
-	inline constexpr const bool __fastcall comp_flag(
-		_CompU32 comp, 
-		uint32_t ignore_mask, 
-		_FlagU32 flag,  
-		_FlagsU32... flags
-	)
-	{
-		static_assert(
-			(std::is_arithmetic_v<_FlagU32> || std::is_enum_v<_FlagU32>) && 
-			(std::is_arithmetic_v<_CompU32> || std::is_enum_v<_CompU32>),
-			"_FlagU32 is not arithmetic type;"
-			"_FlagU32 is not enum type;"
-			"_CompU32 is not arithmetic type;"
-			"_CompU32 is not enum type;"
-			);
-		return ((static_cast<uint32_t>(comp) & ignore_mask) == (static_cast<uint32_t>(flag)))
-			&& comp_flag(comp, flags...);
-	}
-
-	enum class EDefinitionTraits : uint32_t
-	{
-		Numric,
-		Character,
-		String,
-		Array,
-		Expression
-	};
-
-	enum class ENumericTypeTraits : uint32_t
-	{
-		SChar =		0x10000000,
-		UChar =		0x20000000,
-		SShort =	0x30000000,
-		UShort =	0x40000000,
-		SInt =		0x50000000,
-		UInt =		0x60000000,
-		Float =		0x70000000,
-		SLong =		0x80000000,
-		ULong =		0x90000000,
-		SLLong =	0xA0000000,
-		ULLong =	0xB0000000,
-		Double =	0xC0000000,
+		UnexpectedToken,
+		UnknownToken,
+		UnexpectedEnd
 	};
 
-	class Lexeme;
-	class ExpressionLexeme;
-	class DefinitionTokenStructure;
-	class DefinitionTokenStructureDictionaryTreesQueue;
-
-	class ParserAllocator
+	// expected is the token kind the statement needed at offset; for
+	// UnexpectedEnd the offset is the end of the input.
+	struct Diagnostic
 	{
-	public:
-		Lexeme* createLexeme(const char* chars, const uint32_t length)
-		{
-			Lexeme* lexeme = m_lexeme_allocator.allocate(1);
-			m_lexeme_allocator.construct(lexeme, chars, length);
-			m_lexeme_pointers.push_back(lexeme);
-			return lexeme;
-		}
-
-		Lexeme* createLexeme(const char* chars)
-		{
-			Lexeme* lexeme = m_lexeme_allocator.allocate(1);
-			m_lexeme_allocator.construct(lexeme, chars);
-			m_lexeme_pointers.push_back(lexeme);
-			return lexeme;
-		}
-
-		Lexeme* createExpressionLexeme(const char* chars, const uint32_t length);
-
-		Lexeme* createExpressionLexeme(const char* chars);
-
-		void deleteLexeme(Lexeme* lexeme)
-		{
-			m_lexeme_allocator.deallocate(lexeme, 1);
-		}
-
-		void deleteExpressionLexeme(Lexeme* lexeme)
-		{
-			m_expr_lexeme_allocator.deallocate((ExpressionLexeme*)lexeme, 1);
-		}
-
-		template <typename... _String_lexemes>
-		DefinitionTokenStructure* createDefinitionTokenStructure(
-			const uint32_t user_data, 
-			_String_lexemes... lexemes
-		)
-		{
-			DefinitionTokenStructure* def_token_struct = m_def_token_struct_allocator.allocate(1);
-			m_def_token_struct_allocator.construct(def_token_struct, this, user_data, lexemes...);
-			m_def_token_struct_pointers.push_back(def_token_struct);
-			return def_token_struct;
-		}
-
-		void deleteDefinitionTokenStructure(DefinitionTokenStructure* def_token_struct)
-		{
-			m_def_token_struct_allocator.deallocate(def_token_struct, 1);
-		}
-
-		template <typename... _Trees>
-		DefinitionTokenStructureDictionaryTreesQueue* createDefinitionTokenStructureDictionaryTreesQueue(_Trees*... trees)
-		{
-			DefinitionTokenStructureDictionaryTreesQueue* def_token_struct_dict_trees_queue = m_def_token_struct_dict_trees_queue_allocator.allocate(1);
-			m_def_token_struct_dict_trees_queue_allocator.construct(def_token_struct_dict_trees_queue, trees...);
-			m_def_token_struct_dict_trees_queue_pointers.push_back(def_token_struct_dict_trees_queue);
-			return def_token_struct_dict_trees_queue;
-		}
-
-		void deleteDefinitionTokenStructureDictionaryTreesQueue(DefinitionTokenStructureDictionaryTreesQueue* def_token_struct_dict_trees_queue)
-		{
-			m_def_token_struct_dict_trees_queue_allocator.deallocate(def_token_struct_dict_trees_queue, 1);
-		}
-
-	private:
-
-		std::allocator<Lexeme> m_lexeme_allocator;
-		std::list<Lexeme*> m_lexeme_pointers;
-
-		std::allocator<ExpressionLexeme> m_expr_lexeme_allocator;
-
-		std::allocator<DefinitionTokenStructure>  m_def_token_struct_allocator;
-		std::list<DefinitionTokenStructure*> m_def_token_struct_pointers;
-
-		std::allocator<DefinitionTokenStructureDictionaryTreesQueue>  m_def_token_struct_dict_trees_queue_allocator;
-		std::list<DefinitionTokenStructureDictionaryTreesQueue*> m_def_token_struct_dict_trees_queue_pointers;
-
+		EDiagnostic kind;
+		ETokenKind expected;
+		uint64_t offset;
 	};
 
-	class Lexeme
+	// Recognises the statements of a StatementTable one token at a time:
+	// the first token of a statement looks up its form, the following ones
+	// are compared with it. On a mismatch it records a diagnostic and skips
+	// to the next `;`, which it consumes, or `}`, which is read as the next
+	// statement. Each token is looked at once.
+	class StatementRecognizer
 	{
 	public:
-		Lexeme() = default;
-
-		Lexeme(const char* chars, const uint32_t length) :
-			m_chars(chars),
-			m_length(length),
-			m_ull_length((m_length + static_cast<const uint32_t>(sizeof(const uint32_t))) 
-				/ static_cast<const uint32_t>(sizeof(const uint32_t)))
+		explicit StatementRecognizer(const StatementTable& table) :
+			m_table(&table)
 		{
 
 		}
 
-		Lexeme(const char* chars) :
-			m_chars(chars),
-			m_length(static_cast<uint32_t>(strlen(chars))),
-			m_ull_length((m_length + static_cast<const uint32_t>(sizeof(const uint32_t))) 
-				/ static_cast<const uint32_t>(sizeof(const uint32_t)))
+		// True when this token completes a statement; its first token is
+		// then getStatement() and its form's user_data getUserData().
+		bool push(const ETokenKind kind, const uint64_t offset, std::vector<Diagnostic>& diagnostics)
 		{
-
-		}
-
-		bool operator == (const Lexeme& lexeme) const
-		{
-			if (this->m_length != lexeme.m_length || 
-				this->m_chars == nullptr || lexeme.m_chars == nullptr)
+			const size_t index = m_index++;
+			if (m_panic)
 			{
-				return false;
-			}
-			for (uint32_t i = 0; i < this->m_ull_length; i++)
-			{
-				if (reinterpret_cast<const uint32_t*>(this->m_chars)[i] != 
-					reinterpret_cast<const uint32_t*>(lexeme.m_chars)[i])
+				if (kind != ETokenKind::BktFigureClose)
 				{
+					m_panic = kind != ETokenKind::Semicolon;
 					return false;
 				}
+				m_panic = false;
 			}
-			return true;
-		}
-
-		bool operator != (const Lexeme& lexeme) const
-		{
-			if (*this == lexeme)
-			{
-				return false;
-			}
-			else
-			{
-				return true;
-			}
-		}
-
-		bool operator < (const Lexeme& lexeme) const
-		{
-			uint32_t offset = 0;
-			if (this->m_length < lexeme.m_length)
-			{
-				return false;
-			}
-			else if (this->m_length > lexeme.m_length)
-			{
-				return true;
-			}
-			while (this->m_chars[offset] == lexeme.m_chars[offset])
+			if (m_form != StatementTable::no_form)
 			{
-				offset++;
-				if (offset == this->m_length)
+				if (kind == m_kinds[m_matched])
 				{
-					break;
+					return ++m_matched == m_length && this->complete();
 				}
-				if (offset == lexeme.m_length)
+				this->reject(kind, m_kinds[m_matched], offset, diagnostics);
+				if (m_panic || kind != ETokenKind::BktFigureClose)
 				{
-					break;
+					return false;
 				}
 			}
-			if (this->m_chars[offset] < lexeme.m_chars[offset])
-			{
-				return true;
-			}
-			else
+
+			m_form = m_table->getForm(kind);
+			if (m_form == StatementTable::no_form)
 			{
+				this->reject(kind, m_table->getExpectedStart(), offset, diagnostics);
 				return false;
 			}
+			m_statement = index;
+			m_kinds = m_table->getKinds(m_form);
+			m_length = m_table->getLength(m_form);
+			m_matched = 1;
+			return m_matched == m_length && this->complete();
 		}
 
-		bool compareStrict(const char* chars, const uint32_t length) const
+		void finish(const uint64_t end_offset, std::vector<Diagnostic>& diagnostics)
 		{
-			if (this->m_length != length || this->m_chars == nullptr
-				|| chars == nullptr)
+			if (m_form != StatementTable::no_form)
 			{
-				return false;
-			}
-			for (uint32_t i = 0; i < this->m_ull_length; i++)
-			{
-				if (reinterpret_cast<const uint32_t*>(this->m_chars)[i] != 
-					reinterpret_cast<const uint32_t*>(chars)[i])
-				{
-					return false;
-				}
+				diagnostics.push_back({ EDiagnostic::UnexpectedEnd, m_kinds[m_matched], end_offset });
 			}
-			return true;
-		}
-
-		bool compareStrict(const char* chars) const
-		{
-			return this->compareStrict(chars, strlen(chars));
+			m_form = StatementTable::no_form;
+			m_panic = false;
 		}
 
-		virtual bool compare(const char* chars, const uint32_t length) const
+		size_t getStatement() const
 		{
-			if (this->m_length != length || this->m_chars == nullptr 
-				|| chars == nullptr)
-			{
-				return false;
-			}
-			for (uint32_t i = 0; i < this->m_length; i++)
-			{
-				if (this->m_chars[i] != chars[i])
-				{
-					return false;
-				}
-			}
-			return true;
+			return m_statement;
 		}
 
-		bool compare(const char* chars) const
+		uint32_t getUserData() const
 		{
-			return this->compare(chars, strlen(chars));
+			return m_user_data;
 		}
 
-		virtual uint32_t getLength(const char* content) const
+	private:
+		bool complete()
 		{
-			return m_length;
+			m_user_data = m_table->getUserData(m_form);
+			m_form = StatementTable::no_form;
+			return true;
 		}
 
-		const char* getChars() const
+		void reject(const ETokenKind kind, const ETokenKind expected, const uint64_t offset, std::vector<Diagnostic>& diagnostics)
 		{
-			return m_chars;
+			diagnostics.push_back({
+				kind == ETokenKind::Unknown ? EDiagnostic::UnknownToken : EDiagnostic::UnexpectedToken,
+				expected,
+				offset
+			});
+			m_form = StatementTable::no_form;
+			m_panic = kind != ETokenKind::Semicolon && kind != ETokenKind::BktFigureClose;
 		}
 
-	protected:
+		const StatementTable* m_table;
+		const ETokenKind* m_kinds = nullptr;
+		size_t m_index = 0;
+		size_t m_statement = 0;
+		uint32_t m_form = StatementTable::no_form;
 		uint32_t m_length = 0;
-		uint32_t m_ull_length = 0;
-		const char* m_chars = nullptr;
+		uint32_t m_matched = 0;
+		uint32_t m_user_data = 0;
+		bool m_panic = false;
 	};
 
-	class ExpressionLexeme : public Lexeme
+	// Matcher counters per token tree, indexed by ETokenKind, summed over
+	// every parse since the last resetStats(). Zeros unless PRS_STATS.
+	struct ParserStats
 	{
-	public:
-		ExpressionLexeme() = default;
-
-		ExpressionLexeme(const char* chars, const uint32_t length) :
-			Lexeme(chars, length)
-		{
-
-		}
-
-		ExpressionLexeme(const char* chars) :
-			Lexeme(chars)
-		{
-
-		}
-
-		bool compare(const char* chars, const uint32_t length) const override
-		{
-			if (this->m_chars == nullptr || chars == nullptr)
-			{
-				return false;
-			}
-			for (uint32_t i = 0; i < length; i++)
-			{
-				bool finded = false;
-				for (uint32_t l = 0; l < this->m_length; l++)
-				{
-					if (chars[i] == this->m_chars[l])
-					{
-						finded = true;
-						break;
-					}
-				}
-				if (!finded)
-				{
-					return false;
-				}
-			}
-			return true;
-		}
-
-		uint32_t getLength(const char* content) const override
-		{
-			uint32_t lexeme_length = 0;
-			while (content[lexeme_length] != '\0')
-			{
-				bool finded = false;
-				for (uint32_t i = 0; i < this->m_length; i++)
-				{
-					if (content[lexeme_length] == this->m_chars[i])
-					{
-						finded = true;
-						break;
-					}
-				}
-				if (!finded)
-				{
-					break;
-				}
-				lexeme_length++;
-			}
-			return lexeme_length;
-		}
+		MatchStats trees[token_trees_count];
 	};
 
-	inline Lexeme* prs::ParserAllocator::createExpressionLexeme(const char* chars, const uint32_t length)
+	// Everything one input of a batch produced. loaded is false when a file
+	// could not be read; the rest is then empty. The text is gone once the
+	// batch returns, so lines is built while it is still there, but only
+	// for an input with diagnostics.
+	struct ParseResult
 	{
-		ExpressionLexeme* lexeme = m_expr_lexeme_allocator.allocate(1);
-		m_expr_lexeme_allocator.construct(lexeme, chars, length);
-		m_lexeme_pointers.push_back(lexeme);
-		return lexeme;
-	}
+		bool loaded = false;
+		TokenBuffer tokens;
+		std::vector<size_t> declarations;
+		std::vector<Diagnostic> diagnostics;
+		SymbolTable symbols;
+		LineIndex lines;
+	};
 
-	inline Lexeme* ParserAllocator::createExpressionLexeme(const char* chars)
+	// Need not be followed by a '\0' sentinel.
+	struct MemoryInput
 	{
-		ExpressionLexeme* lexeme = m_expr_lexeme_allocator.allocate(1);
-		m_expr_lexeme_allocator.construct(lexeme, chars);
-		m_lexeme_pointers.push_back(lexeme);
-		return lexeme;
-	}
+		const char* content;
+		size_t length;
+	};
 
-	class LexemeComparer
+	// Wall clock of the last batch, from scheduling to the last result.
+	struct BatchStats
 	{
-	public:
-		LexemeComparer() = default;
-
-		LexemeComparer(const Lexeme* ptr_lexeme) : 
-			m_ptr_lexeme(ptr_lexeme)
-		{
-
-		}
-
-		bool operator == (const LexemeComparer& lexeme_comp) const
-		{
-			return *this->m_ptr_lexeme == *lexeme_comp.m_ptr_lexeme;
-		}
+		size_t inputs_count = 0;
+		uint64_t bytes_count = 0;
+		double seconds = 0.0;
 
-		bool operator != (const LexemeComparer& lexeme_comp) const
+		double getInputsPerSecond() const
 		{
-			return *this->m_ptr_lexeme != *lexeme_comp.m_ptr_lexeme;
+			return seconds > 0.0 ? static_cast<double>(inputs_count) / seconds : 0.0;
 		}
 
-		bool operator < (const LexemeComparer& lexeme_comp) const
+		double getBytesPerSecond() const
 		{
-			return *this->m_ptr_lexeme < *lexeme_comp.m_ptr_lexeme;
+			return seconds > 0.0 ? static_cast<double>(bytes_count) / seconds : 0.0;
 		}
-
-		const Lexeme* getLexeme() const
-		{
-			return m_ptr_lexeme;
-		}
-
-	private:
-		const Lexeme* m_ptr_lexeme = nullptr;
 	};
 
-	class DefinitionTokenStructure
+	// Per-parse state only: tokens, declarations, diagnostics and symbols.
+	// The grammar is shared, so a parser is cheap to create, one per thread.
+	class Parser
 	{
 	public:
-		DefinitionTokenStructure() : 
-			m_lexemes(nullptr),
-			m_lexemes_count(0),
-			m_user_data(0)
-		{
-
-		}
-
-		~DefinitionTokenStructure()
+		Parser() :
+			m_grammar(&Grammar::getDefault())
 		{
-			delete[] m_lexemes;
-		}
 
-	private:
-		template <typename _String_lexeme>
-		void create(
-			ParserAllocator* ptr_allocator, 
-			const uint32_t offset, 
-			_String_lexeme lexeme)
-		{
-			if (lexeme[0] == '$')
-			{
-				m_lexemes[offset] = ptr_allocator->createExpressionLexeme(&lexeme[1]);
-			}
-			else
-			{
-				m_lexemes[offset] = ptr_allocator->createLexeme(lexeme);
-			}
 		}
 
-		template <typename _String_lexeme, typename... _String_lexemes>
-		void create(
-			ParserAllocator* ptr_allocator,
-			const uint32_t offset, 
-			_String_lexeme lexeme, 
-			_String_lexemes... lexemes
-		)
+		explicit Parser(const Grammar& grammar) :
+			m_grammar(&grammar)
 		{
-			if (lexeme[0] == '$')
-			{
-				m_lexemes[offset] = ptr_allocator->createExpressionLexeme(&lexeme[1]);
-			}
-			else
-			{
-				m_lexemes[offset] = ptr_allocator->createLexeme(lexeme);
-			}
-			this->create<_String_lexemes...>(ptr_allocator, offset + 1, lexemes...);
-		}
 
-	public:
-		template <typename _String_lexeme, typename... _String_lexemes>
-		DefinitionTokenStructure(
-			ParserAllocator* ptr_allocator,
-			const uint32_t user_data,
-			_String_lexeme lexeme, 
-			_String_lexemes... lexemes
-		) :
-			m_lexemes_count(sizeof...(_String_lexemes) + 1),
-			m_lexemes(new const Lexeme*[m_lexemes_count]),
-			m_user_data(user_data)
-		{
-			this->create<_String_lexeme, _String_lexemes...>(ptr_allocator, 0, lexeme, lexemes...);
 		}
 
-		bool compare(const char* content) const
+		TokenBuffer fromFile(const std::string& file_path)
 		{
-			for (uint32_t i = 0; i < m_lexemes_count; i++)
+			SourceBuffer source;
+			if (!source.mapFile(file_path))
 			{
-				const uint32_t lexeme_length = m_lexemes[i]->getLength(content);
-				if (!m_lexemes[i]->compare(content, lexeme_length))
-				{
-					return false;
-				}
-				content += lexeme_length;
+				return {};
 			}
-			return true;
+			return fromMemory(source.getData(), source.getLength());
 		}
 
-		uint32_t getLength(const char* content) const
+		TokenBuffer fromFile(const std::string& file_path, ThreadPool& pool)
 		{
-			uint32_t length = 0;
-			for (uint32_t i = 0; i < m_lexemes_count; i++)
+			SourceBuffer source;
+			if (!source.mapFile(file_path))
 			{
-				const uint32_t lexeme_length = m_lexemes[i]->getLength(content);
-				length += lexeme_length;
-				content += lexeme_length;
+				return {};
 			}
-			return length;
+			return fromMemory(source.getData(), source.getLength(), pool);
 		}
 
-		const Lexeme* getLexemeAt(const uint32_t index) const
-		{
-			return m_lexemes[index];
-		}
+		static constexpr size_t stream_window_size = 64 * 1024;
 
-		const uint32_t getLexemesCount() const
-		{
-			return m_lexemes_count;
-		}
+		void fromStream(std::istream& stream);
 
-		const uint32_t getUserData() const
+		TokenBuffer fromMemory(const char* content)
 		{
-			return m_user_data;
+			return fromMemory(content, strlen(content));
 		}
 
-		const uint32_t m_lexemes_count;
-		const Lexeme** m_lexemes;
-		const uint32_t m_user_data;
-	};
+		// content must be followed by a '\0' sentinel, as SourceBuffer
+		// guarantees; embedded '\0' bytes before content + length are text.
+		TokenBuffer fromMemory(const char* content, const size_t content_length);
 
-	class DefinitionTokenStructureDictionaryTree;
+		static constexpr size_t parallel_min_chunk_size = 1024 * 1024;
 
-	class DefinitionTokenStructureDictionaryTreeNode
-	{
+		// Same tokens, declarations and symbol ids as the serial overload.
+		// The input is cut after `;` or `}` followed by whitespace, and the
+		// pieces are lexed and parsed on pool, then stitched back in order.
+		TokenBuffer fromMemory(const char* content, const size_t content_length, ThreadPool& pool);
 
-		friend class DefinitionTokenStructureDictionaryTree;
+		// One task per input on pool, all sharing the grammar; results are
+		// in input order. Each worker keeps a scratch buffer for the padded
+		// copies of memory inputs, reused from input to input.
+		std::vector<ParseResult> fromFiles(const std::vector<std::string>& file_paths, ThreadPool& pool);
 
-	public:
-		DefinitionTokenStructureDictionaryTreeNode() = default;
-		
+		std::vector<ParseResult> fromMemory(const std::vector<MemoryInput>& inputs, ThreadPool& pool);
 
-		DefinitionTokenStructure* getDefinitionTokenStructure() const
+		const BatchStats& getBatchStats() const
 		{
-			return m_def_token_struct;
+			return m_batch_stats;
 		}
 
-		bool definitionTokenStructureEmpty() const
+		// Index of the first token of every EStatement::Declaration
+		// statement recognised by the last fromMemory or fromStream call;
+		// for a stream, the index counts the tokens pulled from it.
+		const std::vector<size_t>& getDeclarations() const
 		{
-			return m_def_token_struct == nullptr;
+			return m_declarations;
 		}
 
-		const std::map<LexemeComparer, std::vector<DefinitionTokenStructureDictionaryTreeNode*>>& getNext() const
+		// Statements the last parse could not recognise, in source order.
+		const std::vector<Diagnostic>& getDiagnostics() const
 		{
-			return m_next;
+			return m_diagnostics;
 		}
 
-		bool nextEmpty() const
+		// Identifiers of the last fromMemory call; VariableName tokens carry
+		// their symbol id as user_data.
+		const SymbolTable& getSymbols() const
 		{
-			return m_next.empty();
+			return m_symbols;
 		}
 
-	private:
-		DefinitionTokenStructure* m_def_token_struct = nullptr;
-		std::map<LexemeComparer, std::vector<DefinitionTokenStructureDictionaryTreeNode*>> m_next;
-	};
-
-	class DefinitionTokenStructureDictionaryTree
-	{
-	public:
-		DefinitionTokenStructureDictionaryTree() = default;
-
-		void pushDefinitionTokenStructure(DefinitionTokenStructure* ptr_def_tok_struct)
+		const Grammar& getGrammar() const
 		{
-			const uint32_t lexemes_count = ptr_def_tok_struct->getLexemesCount();
-			DefinitionTokenStructureDictionaryTreeNode* next_node = &m_node;
-			for (uint32_t i = 0; i < lexemes_count; i++)
-			{
-				const Lexeme* key_lexeme = ptr_def_tok_struct->getLexemeAt(i);
-				std::vector<DefinitionTokenStructureDictionaryTreeNode*>& defs = next_node->m_next[LexemeComparer(key_lexeme)];
-				defs.push_back(new DefinitionTokenStructureDictionaryTreeNode());
-				next_node = defs.back();
-			}
-			next_node->m_def_token_struct = ptr_def_tok_struct;
+			return *m_grammar;
 		}
 
-		void pushDefinitionTokenStructures(std::vector<DefinitionTokenStructure*> ptr_def_tok_structs)
+		// Counted on the shared grammar, so parsers running at the same
+		// time on the same grammar see each other's work here.
+		const ParserStats& getStats() const
 		{
-			for (auto ptr_def_tok_struct : ptr_def_tok_structs)
-			{
-				pushDefinitionTokenStructure(ptr_def_tok_struct);
-			}
+			return m_stats;
 		}
 
-		void findByChars(
-			const char* chars, 
-			DefinitionTokenStructure** pptr_def_tok_struct,
-			DefinitionTokenStructureDictionaryTreeNode& node
-		)
+		void resetStats()
 		{
-			if (node.m_next.empty())
-			{
-				if (chars[0] == ' ' || chars[0] == '\0' || chars[0] == '\n' || chars[0] == '\t')
-				{
-					if (*pptr_def_tok_struct == nullptr)
-					{
-						*pptr_def_tok_struct = node.m_def_token_struct;
-					}
-					else if (node.m_def_token_struct != nullptr)
-					{
-						if (node.m_def_token_struct->getLexemesCount() > (*pptr_def_tok_struct)->getLexemesCount())
-						{
-							*pptr_def_tok_struct = node.m_def_token_struct;
-						}
-					}
-				}
-			}
-			for (decltype(auto) pair : node.m_next)
-			{
-				const Lexeme* lexeme = pair.first.getLexeme();
-				const uint32_t lexeme_length = lexeme->getLength(chars);
-				if (lexeme == nullptr)
-				{
-					return;
-				}
-				else if (lexeme->compare(chars, lexeme_length))
-				{
-					for (int i = 0 ; i < pair.second.size(); i++)
-					{
-						findByChars(&chars[lexeme_length], pptr_def_tok_struct, *pair.second[i]);
-					}
-				}
-			}
-		}
-
-		void findByChars(
-			const char* chars,
-			DefinitionTokenStructure** pptr_def_tok_struct
-		)
-		{
-			if (*chars == ' ' || *chars == '\n' || *chars == '\t' || *chars == '\0')
-			{
-				return;
-			}
-			findByChars(chars, pptr_def_tok_struct, m_node);
-		}
-
-	private:
-		DefinitionTokenStructureDictionaryTreeNode m_node;
-	};
-
-	class DefinitionTokenStructureDictionaryTrees
-	{
-	private:
-		template <typename... _String_lexemes>
-		void add(
-			DefinitionTokenStructureDictionaryTree& tree,
-			const uint32_t user_data, 
-			_String_lexemes... lexemes
-		)
-		{
-			tree.pushDefinitionTokenStructure(m_allocator.createDefinitionTokenStructure(user_data, lexemes...));
-		}
-
-	public:
-		DefinitionTokenStructureDictionaryTrees(ParserAllocator& allocator) : 
-			m_allocator(allocator)
-		{
-			constexpr uint32_t float_type_flag = make_flag(ENumericTypeTraits::Float);
-			constexpr uint32_t double_type_flag = make_flag(ENumericTypeTraits::Double);
-			constexpr uint32_t int_type_flag = make_flag(ENumericTypeTraits::SInt);
-
-			this->add(tree_bkt_figure_open, NULL, "{");
-			this->add(tree_bkt_figure_close, NULL, "}");
-			this->add(tree_assignment, NULL, "=");
-			this->add(tree_semicolon, NULL, ";");
-
-			this->add(tree_variable_name, NULL, "$_qwertyuiopasdfghjklzxcvbnmQWERTYUIOPASDFGHJKLZXCVBNM1234567890");
-
-			this->add(tree_type, NULL, "const", "$ ", "int");
-			this->add(tree_type, NULL, "const", "$ ", "float");
-			this->add(tree_type, NULL, "const", "$ ", "double");
-			this->add(tree_type, NULL, "const", "$ ", "long");
-
-			this->add(tree_numeric, float_type_flag, "+", "$0123456789", ".", "$0123456789", "f");
-			this->add(tree_numeric, float_type_flag, "+", "$0123456789", ".", "$0123456789", "F");
-			this->add(tree_numeric, float_type_flag, "+", "$0123456789", ".", "f");
-			this->add(tree_numeric, float_type_flag, "+", "$0123456789", ".", "F");
-			this->add(tree_numeric, float_type_flag, "-", "$0123456789", ".", "$0123456789", "f");
-			this->add(tree_numeric, float_type_flag, "-", "$0123456789", ".", "$0123456789", "F");
-			this->add(tree_numeric, float_type_flag, "-", "$0123456789", ".", "f");
-			this->add(tree_numeric, float_type_flag, "-", "$0123456789", ".", "F");
-			this->add(tree_numeric, float_type_flag, "$0123456789", ".", "$0123456789", "f");
-			this->add(tree_numeric, float_type_flag, "$0123456789", ".", "$0123456789", "F");
-			this->add(tree_numeric, float_type_flag, "$0123456789", ".", "f");
-			this->add(tree_numeric, float_type_flag, "$0123456789", ".", "F");
-			this->add(tree_numeric, float_type_flag, "-", ".", "$0123456789", "f");
-			this->add(tree_numeric, float_type_flag, "-", ".", "$0123456789", "F");
-			this->add(tree_numeric, float_type_flag, "+", ".", "$0123456789", "f");
-			this->add(tree_numeric, float_type_flag, "+", ".", "$0123456789", "F");
-			this->add(tree_numeric, float_type_flag, ".", "$0123456789", "f");
-			this->add(tree_numeric, float_type_flag, ".", "$0123456789", "F");
-
-			this->add(tree_numeric, int_type_flag, "+", "$0123456789");
-			this->add(tree_numeric, int_type_flag, "-", "$0123456789");
-			this->add(tree_numeric, int_type_flag, "$0123456789");
-
-			this->add(tree_numeric, double_type_flag, "+", "$0123456789", ".", "$0123456789", "d");
-			this->add(tree_numeric, double_type_flag, "+", "$0123456789", ".", "$0123456789", "D");
-			this->add(tree_numeric, double_type_flag, "+", "$0123456789", ".", "d");
-			this->add(tree_numeric, double_type_flag, "+", "$0123456789", ".", "D");
-			this->add(tree_numeric, double_type_flag, "-", "$0123456789", ".", "$0123456789", "d");
-			this->add(tree_numeric, double_type_flag, "-", "$0123456789", ".", "$0123456789", "D");
-			this->add(tree_numeric, double_type_flag, "-", "$0123456789", ".", "d");
-			this->add(tree_numeric, double_type_flag, "-", "$0123456789", ".", "D");
-			this->add(tree_numeric, double_type_flag, "$0123456789", ".", "$0123456789", "d");
-			this->add(tree_numeric, double_type_flag, "$0123456789", ".", "$0123456789", "D");
-			this->add(tree_numeric, double_type_flag, "$0123456789", ".", "d");
-			this->add(tree_numeric, double_type_flag, "$0123456789", ".", "D");
-			this->add(tree_numeric, double_type_flag, "-", ".", "$0123456789", "d");
-			this->add(tree_numeric, double_type_flag, "-", ".", "$0123456789", "D");
-			this->add(tree_numeric, double_type_flag, "+", ".", "$0123456789", "d");
-			this->add(tree_numeric, double_type_flag, "+", ".", "$0123456789", "D");
-			this->add(tree_numeric, double_type_flag, ".", "$0123456789", "d");
-			this->add(tree_numeric, double_type_flag, ".", "$0123456789", "D");
-			this->add(tree_numeric, double_type_flag, "+", "$0123456789", ".", "$0123456789");
-			this->add(tree_numeric, double_type_flag, "+", "$0123456789", ".");
-			this->add(tree_numeric, double_type_flag, "-", "$0123456789", ".", "$0123456789");
-			this->add(tree_numeric, double_type_flag, "-", "$0123456789", ".");
-			this->add(tree_numeric, double_type_flag, "$0123456789", ".", "$0123456789");
-			this->add(tree_numeric, double_type_flag, "$0123456789", ".");
-			this->add(tree_numeric, double_type_flag, "-", ".", "$0123456789");
-			this->add(tree_numeric, double_type_flag, "+", ".", "$0123456789");
-			this->add(tree_numeric, double_type_flag, ".", "$0123456789");
+			m_stats = ParserStats();
 		}
 
-		DefinitionTokenStructureDictionaryTree tree_type;
-		DefinitionTokenStructureDictionaryTree tree_variable_name;
-		DefinitionTokenStructureDictionaryTree tree_numeric;
-		DefinitionTokenStructureDictionaryTree tree_bkt_figure_open;
-		DefinitionTokenStructureDictionaryTree tree_bkt_figure_close;
-		DefinitionTokenStructureDictionaryTree tree_semicolon;
-		DefinitionTokenStructureDictionaryTree tree_assignment;
+		void dumpStats(std::ostream& stream) const;
 
 	private:
-		ParserAllocator& m_allocator;
-	};
+		ParserStats snapshotStats() const;
 
-	class DefinitionTokenStructureDictionaryTreesQueue
-	{
-	public:
-		DefinitionTokenStructureDictionaryTreesQueue() = default;
+		void collectStats(const ParserStats& before);
 
-		template <typename _Tree, typename... _Trees>
-		DefinitionTokenStructureDictionaryTreesQueue(_Tree* tree, _Trees*... trees) : 
-			m_length(sizeof...(_Trees) + 1),
-			m_trees(new DefinitionTokenStructureDictionaryTree*[m_length])
-		{
-			this->create(0, tree, trees...);
-		}
+		static void findDeclarations(
+			const StatementTable& statements,
+			const TokenBuffer& tokens,
+			const size_t content_length,
+			std::vector<size_t>& declarations,
+			std::vector<Diagnostic>& diagnostics
+		);
 
-		uint32_t getLength() const
-		{
-			return m_length;
-		}
+		void parse(const char* content, const size_t content_length, ParseResult& result) const;
 
-		DefinitionTokenStructureDictionaryTree* getTreeAt(uint32_t index) const
-		{
-			return m_trees[index];
-		}
+		static size_t findSplit(const char* content, const size_t previous, const size_t from, const size_t content_length);
 
-		std::vector<uint32_t> compare(const char** ptr_content) const
-		{
-			std::vector<uint32_t> user_data_queue;
-			for (uint32_t i = 0; i < m_length; i++)
-			{
-				_priv::skip_space(ptr_content);
-				DefinitionTokenStructure* def_tok_struct = nullptr;
-				m_trees[i]->findByChars(*ptr_content, &def_tok_struct);
-				if (def_tok_struct == nullptr)
-				{
-					return {};
-				}
-				user_data_queue.push_back(def_tok_struct->getUserData());
-				*ptr_content += def_tok_struct->getLength(*ptr_content);
-			}
-			return user_data_queue;
-		}
-
-	private:
-		template <typename _Tree>
-		void create(const uint32_t offset, _Tree* tree)
-		{
-			static_assert(std::is_same_v<_Tree, DefinitionTokenStructureDictionaryTree>);
-			static_assert(std::is_same_v<_Tree, DefinitionTokenStructureDictionaryTree>);
-			m_trees[offset] = tree;
-		}
-
-		template <typename _Tree, typename... _Trees>
-		void create(const uint32_t offset, _Tree* tree, _Trees*... trees)
-		{
-			static_assert(std::is_same_v<_Tree, DefinitionTokenStructureDictionaryTree>);
-			m_trees[offset] = tree;
-			this->create(offset + 1, trees...);
-		}
-
-		const uint32_t m_length;
-		DefinitionTokenStructureDictionaryTree** m_trees;
-	};
-
-	class Parser
-	{
-	public:
-		void fromFile(const std::string& file_path)
-		{
-			std::string file_content;
-			std::getline(std::ifstream(file_path), file_content, '\0');
-			fromMemory(file_content.data());
-
-		}
-
-		void fromMemory(const char* content)
-		{
-			ParserAllocator allocator;
-			DefinitionTokenStructureDictionaryTrees trees(allocator);
-			DefinitionTokenStructureDictionaryTreesQueue* queue = allocator.createDefinitionTokenStructureDictionaryTreesQueue(&trees.tree_type, &trees.tree_numeric);
-			DefinitionTokenStructure* ptr_def_tok_struct = nullptr;	
-
-
-			while (*content != '\0')
-			{
-				_priv::skip_space(&content);
-				trees.tree_type.findByChars(content, &ptr_def_tok_struct);
-				if (ptr_def_tok_struct != nullptr)
-				{
-					content += ptr_def_tok_struct->getLength(content);
-					ptr_def_tok_struct = nullptr;
-					trees.tree_variable_name.findByChars(content, &ptr_def_tok_struct);
-					if (ptr_def_tok_struct != nullptr)
-					{
-						content += ptr_def_tok_struct->getLength(content);
-						ptr_def_tok_struct = nullptr;
-						trees.tree_assignment.findByChars(content, &ptr_def_tok_struct);
-						if (ptr_def_tok_struct != nullptr)
-						{
-							content += ptr_def_tok_struct->getLength(content);
-							ptr_def_tok_struct = nullptr;
-							trees.tree_numeric.findByChars(content, &ptr_def_tok_struct);
-							if (ptr_def_tok_struct != nullptr)
-							{
-								content += ptr_def_tok_struct->getLength(content);
-								ptr_def_tok_struct = nullptr;
-								trees.tree_semicolon.findByChars(content, &ptr_def_tok_struct);
-								if (ptr_def_tok_struct != nullptr)
-								{
-									content += ptr_def_tok_struct->getLength(content);
-									ptr_def_tok_struct = nullptr;
-									std::cout << "good";
-								}
-							}
-						}
-					}
-				}
-			}
-		
-		}
-
-	private:
-		
+		const Grammar* m_grammar;
+		std::vector<size_t> m_declarations;
+		std::vector<Diagnostic> m_diagnostics;
+		SymbolTable m_symbols;
+		ParserStats m_stats;
+		BatchStats m_batch_stats;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,158 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace prs
+{
+	// Bump allocator: objects are placed back to back in large chunks and
+	// are only released all together. Destructors of non-trivial objects are
+	// chained inside the arena itself and run in reverse order on release.
+	class ParserArena
+	{
+	public:
+		static constexpr size_t default_chunk_size = 64 * 1024;
+
+		explicit ParserArena(const size_t chunk_size = default_chunk_size) :
+			m_chunk_size(chunk_size)
+		{
+
+		}
+
+		ParserArena(const ParserArena&) = delete;
+		ParserArena& operator = (const ParserArena&) = delete;
+
+		~ParserArena()
+		{
+			this->release();
+		}
+
+		void* allocate(const size_t size, const size_t alignment)
+		{
+			uintptr_t address = (reinterpret_cast<uintptr_t>(m_cursor) + alignment - 1) & ~(alignment - 1);
+			if (m_cursor == nullptr || address + size > reinterpret_cast<uintptr_t>(m_end))
+			{
+				if (size + alignment > m_chunk_size / 4)
+				{
+					return this->allocateLarge(size, alignment);
+				}
+				this->pushChunk(m_chunk_size);
+				address = (reinterpret_cast<uintptr_t>(m_cursor) + alignment - 1) & ~(alignment - 1);
+			}
+			m_cursor = reinterpret_cast<char*>(address + size);
+			return reinterpret_cast<void*>(address);
+		}
+
+		template <typename _Type, typename... _Args>
+		_Type* create(_Args&&... args)
+		{
+			void* memory = this->allocate(sizeof(_Type), alignof(_Type));
+			_Type* object = ::new (memory) _Type(std::forward<_Args>(args)...);
+			if (!std::is_trivially_destructible<_Type>::value)
+			{
+				Destructor* destructor = static_cast<Destructor*>(this->allocate(sizeof(Destructor), alignof(Destructor)));
+				destructor->prev = m_destructors;
+				destructor->destroy = [](void* ptr) { static_cast<_Type*>(ptr)->~_Type(); };
+				destructor->object = object;
+				m_destructors = destructor;
+			}
+			return object;
+		}
+
+		template <typename _Type>
+		_Type* allocateArray(const size_t count)
+		{
+			static_assert(std::is_trivially_destructible<_Type>::value, "_Type is not trivially destructible;");
+			_Type* array = static_cast<_Type*>(this->allocate(sizeof(_Type) * count, alignof(_Type)));
+			for (size_t i = 0; i < count; i++)
+			{
+				::new (&array[i]) _Type();
+			}
+			return array;
+		}
+
+		void release()
+		{
+			while (m_destructors != nullptr)
+			{
+				Destructor* destructor = m_destructors;
+				m_destructors = destructor->prev;
+				destructor->destroy(destructor->object);
+			}
+			while (m_chunk != nullptr)
+			{
+				Chunk* chunk = m_chunk;
+				m_chunk = chunk->prev;
+				::operator delete(chunk);
+			}
+			m_cursor = nullptr;
+			m_end = nullptr;
+			m_chunks_count = 0;
+			m_reserved_bytes = 0;
+		}
+
+		size_t getChunksCount() const
+		{
+			return m_chunks_count;
+		}
+
+		size_t getReservedBytes() const
+		{
+			return m_reserved_bytes;
+		}
+
+	private:
+		struct Chunk
+		{
+			Chunk* prev;
+		};
+
+		struct Destructor
+		{
+			Destructor* prev;
+			void (*destroy)(void*);
+			void* object;
+		};
+
+		char* newChunk(const size_t size, Chunk* prev)
+		{
+			Chunk* chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk) + size));
+			chunk->prev = prev;
+			m_chunks_count++;
+			m_reserved_bytes += sizeof(Chunk) + size;
+			return reinterpret_cast<char*>(chunk + 1);
+		}
+
+		void pushChunk(const size_t size)
+		{
+			m_cursor = this->newChunk(size, m_chunk);
+			m_end = m_cursor + size;
+			m_chunk = reinterpret_cast<Chunk*>(m_cursor) - 1;
+		}
+
+		// Oversized requests get a chunk of their own, linked under the
+		// current one so the free space of the current chunk is kept.
+		void* allocateLarge(const size_t size, const size_t alignment)
+		{
+			if (m_chunk == nullptr)
+			{
+				this->pushChunk(m_chunk_size);
+			}
+			char* data = this->newChunk(size + alignment, m_chunk->prev);
+			m_chunk->prev = reinterpret_cast<Chunk*>(data) - 1;
+			const uintptr_t address = (reinterpret_cast<uintptr_t>(data) + alignment - 1) & ~(alignment - 1);
+			return reinterpret_cast<void*>(address);
+		}
+
+		const size_t m_chunk_size;
+		Chunk* m_chunk = nullptr;
+		char* m_cursor = nullptr;
+		char* m_end = nullptr;
+		Destructor* m_destructors = nullptr;
+		size_t m_chunks_count = 0;
+		size_t m_reserved_bytes = 0;
+	};
+}
@@ -0,0 +1,244 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <vector>
+#include <utility>
+#include "LineIndex.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+namespace prs
+{
+	// Read-only program text followed by at least `padding` zero bytes, so
+	// every scanner may stop on '\0' and read a SIMD block past the end.
+	// On Linux files are mapped instead of copied; elsewhere, and for
+	// in-memory sources, the text is copied once into a padded buffer.
+	class SourceBuffer
+	{
+	public:
+		static constexpr size_t padding = 64;
+
+		SourceBuffer() = default;
+
+		SourceBuffer(const SourceBuffer&) = delete;
+		SourceBuffer& operator = (const SourceBuffer&) = delete;
+
+		SourceBuffer(SourceBuffer&& source) noexcept
+		{
+			*this = std::move(source);
+		}
+
+		SourceBuffer& operator = (SourceBuffer&& source) noexcept
+		{
+			if (this != &source)
+			{
+				this->release();
+				m_heap = std::move(source.m_heap);
+				m_data = source.m_data;
+				m_length = source.m_length;
+				m_mapping = source.m_mapping;
+				m_mapping_length = source.m_mapping_length;
+				m_lines = std::move(source.m_lines);
+				source.m_lines.clear();
+				source.m_data = nullptr;
+				source.m_length = 0;
+				source.m_mapping = nullptr;
+				source.m_mapping_length = 0;
+			}
+			return *this;
+		}
+
+		~SourceBuffer()
+		{
+			this->release();
+		}
+
+		bool mapFile(const std::string& file_path)
+		{
+#if defined(__linux__)
+			this->release();
+			const int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+			{
+				return false;
+			}
+			struct stat file_stat;
+			if (::fstat(fd, &file_stat) != 0)
+			{
+				::close(fd);
+				return false;
+			}
+			if (!S_ISREG(file_stat.st_mode))
+			{
+				// Pipes and devices can be neither mapped nor reopened:
+				// read the descriptor already open.
+				const bool success = this->readDescriptor(fd);
+				::close(fd);
+				return success;
+			}
+			const size_t length = static_cast<size_t>(file_stat.st_size);
+			const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+			const size_t mapping_length = (length + padding + page_size - 1) / page_size * page_size;
+
+			// Reserve zeroed anonymous pages for text plus padding, then map
+			// the file over the front of the reservation. The bytes after
+			// the end of the file read as zero in both regions.
+			void* mapping = ::mmap(nullptr, mapping_length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mapping == MAP_FAILED)
+			{
+				::close(fd);
+				return false;
+			}
+			if (length != 0 &&
+				::mmap(mapping, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+			{
+				::munmap(mapping, mapping_length);
+				::close(fd);
+				return false;
+			}
+			::close(fd);
+			::madvise(mapping, mapping_length, MADV_SEQUENTIAL);
+			m_mapping = mapping;
+			m_mapping_length = mapping_length;
+			m_data = static_cast<const char*>(mapping);
+			m_length = length;
+			return true;
+#else
+			return this->readFile(file_path);
+#endif
+		}
+
+		// Reads to the end rather than by size, so a file that cannot seek
+		// reads as well.
+		bool readFile(const std::string& file_path)
+		{
+			this->release();
+			std::ifstream file(file_path, std::ios::binary);
+			if (!file)
+			{
+				return false;
+			}
+			size_t length = 0;
+			while (file)
+			{
+				m_heap.resize(length + read_chunk_size);
+				file.read(m_heap.data() + length, static_cast<std::streamsize>(read_chunk_size));
+				length += static_cast<size_t>(file.gcount());
+			}
+			if (file.bad())
+			{
+				m_heap.clear();
+				return false;
+			}
+			this->setHeapLength(length);
+			return true;
+		}
+
+		void assign(const char* content, const size_t length)
+		{
+			this->release();
+			m_heap.assign(length + padding, '\0');
+			memcpy(m_heap.data(), content, length);
+			m_data = m_heap.data();
+			m_length = length;
+		}
+
+		const char* getData() const
+		{
+			return m_data;
+		}
+
+		size_t getLength() const
+		{
+			return m_length;
+		}
+
+		bool isMapped() const
+		{
+			return m_mapping != nullptr;
+		}
+
+		// The line index is built on the first call, so a parse that needs
+		// no location never pays for it; that first call must not race
+		// with another.
+		SourceLocation getLocation(const uint64_t offset) const
+		{
+			if (!m_lines.isBuilt())
+			{
+				m_lines.build(m_data, m_length);
+			}
+			return m_lines.getLocation(offset);
+		}
+
+	private:
+		static constexpr size_t read_chunk_size = 64 * 1024;
+
+#if defined(__linux__)
+		bool readDescriptor(const int fd)
+		{
+			size_t length = 0;
+			for (;;)
+			{
+				m_heap.resize(length + read_chunk_size);
+				const ssize_t count = ::read(fd, m_heap.data() + length, read_chunk_size);
+				if (count > 0)
+				{
+					length += static_cast<size_t>(count);
+				}
+				else if (count == 0)
+				{
+					break;
+				}
+				else if (errno != EINTR)
+				{
+					m_heap.clear();
+					return false;
+				}
+			}
+			this->setHeapLength(length);
+			return true;
+		}
+#endif
+
+		// A chunk may have been read only in part: zero what follows.
+		void setHeapLength(const size_t length)
+		{
+			m_heap.resize(length + padding);
+			memset(m_heap.data() + length, 0, padding);
+			m_data = m_heap.data();
+			m_length = length;
+		}
+
+		void release()
+		{
+#if defined(__linux__)
+			if (m_mapping != nullptr)
+			{
+				::munmap(m_mapping, m_mapping_length);
+			}
+#endif
+			m_mapping = nullptr;
+			m_mapping_length = 0;
+			m_heap.clear();
+			m_lines.clear();
+			m_data = nullptr;
+			m_length = 0;
+		}
+
+		std::vector<char> m_heap;
+		const char* m_data = nullptr;
+		size_t m_length = 0;
+		void* m_mapping = nullptr;
+		size_t m_mapping_length = 0;
+		mutable LineIndex m_lines;
+	};
+}
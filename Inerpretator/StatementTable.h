@@ -0,0 +1,139 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Lexer.h"
+
+
+namespace prs
+{
+	// user_data of the built-in statement forms; forms added later may use
+	// any other value.
+	enum class EStatement : uint32_t
+	{
+		Declaration,
+		Empty,
+		BlockOpen,
+		BlockClose
+	};
+
+	// Statement forms as data: each is a sequence of token kinds. No two
+	// forms may start with the same kind, so the table is LL(1): the first
+	// token of a statement picks its form with one lookup, and the rest is
+	// compared kind by kind, however many forms there are.
+	class StatementTable
+	{
+	public:
+		static constexpr uint32_t no_form = UINT32_MAX;
+
+		StatementTable()
+		{
+			m_first.fill(no_form);
+		}
+
+		// False, and nothing is added, for an empty form, one that holds
+		// Unknown, one with `;` or `}` before its last kind, or one whose
+		// first kind already starts another form. Recovery skips to the next
+		// `;` or `}` as the end of a statement, so neither may occur inside
+		// one.
+		bool add(const uint32_t user_data, const ETokenKind* kinds, const uint32_t length)
+		{
+			for (uint32_t i = 0; i < length; i++)
+			{
+				if (static_cast<uint32_t>(kinds[i]) >= token_trees_count)
+				{
+					return false;
+				}
+				if (i + 1 < length && (kinds[i] == ETokenKind::Semicolon || kinds[i] == ETokenKind::BktFigureClose))
+				{
+					return false;
+				}
+			}
+			if (length == 0 || m_first[static_cast<uint32_t>(kinds[0])] != no_form)
+			{
+				return false;
+			}
+			m_first[static_cast<uint32_t>(kinds[0])] = static_cast<uint32_t>(m_forms.size());
+			m_forms.push_back({ static_cast<uint32_t>(m_kinds.size()), length, user_data });
+			m_kinds.insert(m_kinds.end(), kinds, kinds + length);
+			return true;
+		}
+
+		template <uint32_t _Length>
+		bool add(const EStatement statement, const ETokenKind (&kinds)[_Length])
+		{
+			return this->add(static_cast<uint32_t>(statement), kinds, _Length);
+		}
+
+		// The form is the queue's trees in order; every tree must be one
+		// of trees. False if one is not, or as for the overload above.
+		bool add(
+			const uint32_t user_data,
+			const DefinitionTokenStructureDictionaryTreesQueue& queue,
+			const DefinitionTokenStructureDictionaryTrees& trees
+		)
+		{
+			std::vector<ETokenKind> kinds(queue.getLength());
+			for (uint32_t i = 0; i < queue.getLength(); i++)
+			{
+				uint32_t kind = 0;
+				while (kind < token_trees_count && &getTokenTree(trees, static_cast<ETokenKind>(kind)) != queue.getTreeAt(i))
+				{
+					kind++;
+				}
+				if (kind == token_trees_count)
+				{
+					return false;
+				}
+				kinds[i] = static_cast<ETokenKind>(kind);
+			}
+			return this->add(user_data, kinds.data(), queue.getLength());
+		}
+
+		// no_form if no statement starts with kind.
+		uint32_t getForm(const ETokenKind kind) const
+		{
+			return m_first[static_cast<uint32_t>(kind)];
+		}
+
+		uint32_t getFormsCount() const
+		{
+			return static_cast<uint32_t>(m_forms.size());
+		}
+
+		const ETokenKind* getKinds(const uint32_t form) const
+		{
+			return m_kinds.data() + m_forms[form].offset;
+		}
+
+		uint32_t getLength(const uint32_t form) const
+		{
+			return m_forms[form].length;
+		}
+
+		uint32_t getUserData(const uint32_t form) const
+		{
+			return m_forms[form].user_data;
+		}
+
+		// What a diagnostic expects where a statement should start: the
+		// first kind of the first form.
+		ETokenKind getExpectedStart() const
+		{
+			return m_kinds.empty() ? ETokenKind::Unknown : m_kinds[0];
+		}
+
+	private:
+		struct Form
+		{
+			uint32_t offset;
+			uint32_t length;
+			uint32_t user_data;
+		};
+
+		// One slot more for Unknown, which starts no form.
+		std::array<uint32_t, token_trees_count + 1> m_first;
+		std::vector<Form> m_forms;
+		std::vector<ETokenKind> m_kinds;
+	};
+}
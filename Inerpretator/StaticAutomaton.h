@@ -0,0 +1,374 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "Lexer.h"
+
+
+namespace prs
+{
+	namespace _priv
+	{
+		constexpr uint32_t __fastcall static_length(const char* chars)
+		{
+			uint32_t length = 0;
+			while (chars[length] != '\0')
+			{
+				length++;
+			}
+			return length;
+		}
+
+		constexpr bool __fastcall static_equal(const char* left, const char* right)
+		{
+			uint32_t i = 0;
+			while (left[i] != '\0' && left[i] == right[i])
+			{
+				i++;
+			}
+			return left[i] == right[i];
+		}
+
+		constexpr bool __fastcall static_contains(const char* chars, const char c)
+		{
+			for (uint32_t i = 0; chars[i] != '\0'; i++)
+			{
+				if (chars[i] == c)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		constexpr uint32_t __fastcall static_trailing_zeros64(const uint64_t mask)
+		{
+			constexpr uint8_t de_bruijn[64] = {
+				0, 1, 2, 53, 3, 7, 54, 27, 4, 38, 41, 8, 34, 55, 48, 28,
+				62, 5, 39, 46, 44, 42, 22, 9, 24, 35, 59, 56, 49, 18, 29, 11,
+				63, 52, 6, 26, 37, 40, 33, 47, 61, 45, 43, 21, 23, 58, 17, 10,
+				51, 25, 36, 32, 60, 20, 57, 16, 50, 31, 19, 15, 30, 14, 13, 12
+			};
+			return de_bruijn[((mask & (~mask + 1)) * 0x022FDD63CC95386Dull) >> 58];
+		}
+
+		// ByteClasses::split, in a form the compiler can evaluate.
+		template <typename _Predicate>
+		constexpr void static_split(uint8_t (&classes)[256], uint32_t& count, _Predicate member)
+		{
+			// Ids are stored one up, so zero means none yet.
+			uint16_t remap[512] = {};
+			count = 0;
+			for (uint32_t b = 0; b < 256; b++)
+			{
+				const uint32_t key = classes[b] * 2u + (member(static_cast<char>(b)) ? 1u : 0u);
+				if (remap[key] == 0)
+				{
+					remap[key] = static_cast<uint16_t>(++count);
+				}
+				classes[b] = static_cast<uint8_t>(remap[key] - 1);
+			}
+		}
+	}
+
+	// Working storage of the compile-time construction. The capacities only
+	// bound it; the tables that end up in the program are cut to size.
+	template <uint32_t _States, uint32_t _Classes, uint32_t _Positions>
+	struct StaticAutomatonBuild
+	{
+		static constexpr uint32_t words_count = (_Positions + 63) / 64;
+
+		uint8_t byte_classes[256] = {};
+		uint32_t classes_count = 1;
+		uint32_t states_count = 0;
+		uint32_t transitions[_States * _Classes] = {};
+		int32_t accepts[_States * _Classes] = {};
+		uint64_t states[_States][words_count] = {};
+		bool overflow = false;
+	};
+
+	// DefinitionTokenStructureAutomaton::compile() run by the compiler: the
+	// same byte classes, split in the same order, and the same subset
+	// construction, with each DFA state a bit set of (pattern, lexeme,
+	// offset) positions. States are numbered as compile() numbers them, so
+	// the tables come out identical.
+	template <uint32_t _States, uint32_t _Classes, uint32_t _Positions, uint32_t _Capacity>
+	constexpr StaticAutomatonBuild<_States, _Classes, _Positions> buildStaticAutomaton(
+		const StaticTokenTree<_Capacity>& tree
+	)
+	{
+		using Build = StaticAutomatonBuild<_States, _Classes, _Positions>;
+		Build build{};
+		const uint32_t patterns_count = tree.getPatternsCount();
+
+		// A split by a set already split by changes nothing, not even the
+		// numbering, so repeated keys and expressions are skipped.
+		_priv::static_split(build.byte_classes, build.classes_count,
+			[](const char c) { return _priv::is_terminator(c); });
+		bool split_keys[256] = {};
+		for (uint32_t p = 0; p < patterns_count; p++)
+		{
+			const StaticTokenPattern& pattern = tree.getPatternAt(p);
+			for (uint32_t e = 0; e < pattern.lexemes_count; e++)
+			{
+				const char* lexeme = pattern.lexemes[e];
+				if (lexeme[0] == '$')
+				{
+					bool seen = false;
+					for (uint32_t q = 0; q <= p && !seen; q++)
+					{
+						const StaticTokenPattern& earlier = tree.getPatternAt(q);
+						for (uint32_t f = 0; f < (q == p ? e : earlier.lexemes_count) && !seen; f++)
+						{
+							seen = _priv::static_equal(earlier.lexemes[f], lexeme);
+						}
+					}
+					if (!seen)
+					{
+						_priv::static_split(build.byte_classes, build.classes_count,
+							[lexeme](const char c) { return _priv::static_contains(lexeme + 1, c); });
+					}
+				}
+				else
+				{
+					for (uint32_t l = 0; lexeme[l] != '\0'; l++)
+					{
+						const char key = lexeme[l];
+						if (!split_keys[static_cast<uint8_t>(key)])
+						{
+							split_keys[static_cast<uint8_t>(key)] = true;
+							_priv::static_split(build.byte_classes, build.classes_count,
+								[key](const char c) { return c == key; });
+						}
+					}
+				}
+			}
+		}
+		if (build.classes_count > _Classes)
+		{
+			build.overflow = true;
+			return build;
+		}
+		char representatives[256] = {};
+		for (uint32_t b = 256; b-- > 0;)
+		{
+			representatives[build.byte_classes[b]] = static_cast<char>(b);
+		}
+
+		// A literal lexeme has a position per byte, an expression one, and
+		// every pattern one past its last lexeme.
+		uint32_t element_positions[_Capacity][static_lexemes_capacity + 1] = {};
+		uint32_t position_pattern[_Positions] = {};
+		uint32_t position_element[_Positions] = {};
+		uint32_t position_offset[_Positions] = {};
+		uint32_t positions_count = 0;
+		for (uint32_t p = 0; p < patterns_count; p++)
+		{
+			const StaticTokenPattern& pattern = tree.getPatternAt(p);
+			for (uint32_t e = 0; e <= pattern.lexemes_count; e++)
+			{
+				const char* lexeme = e < pattern.lexemes_count ? pattern.lexemes[e] : "";
+				const uint32_t length = lexeme[0] == '$' ? 1 : _priv::static_length(lexeme);
+				const uint32_t width = length == 0 ? 1 : length;
+				if (positions_count + width > _Positions)
+				{
+					build.overflow = true;
+					return build;
+				}
+				element_positions[p][e] = positions_count;
+				for (uint32_t o = 0; o < width; o++)
+				{
+					position_pattern[positions_count] = p;
+					position_element[positions_count] = e;
+					position_offset[positions_count] = o;
+					positions_count++;
+				}
+			}
+		}
+
+		build.states_count = 2;
+		for (uint32_t p = 0; p < patterns_count; p++)
+		{
+			const uint32_t position = element_positions[p][0];
+			build.states[DefinitionTokenStructureAutomaton::start_state][position / 64] |= uint64_t(1) << (position % 64);
+		}
+
+		for (uint32_t id = 0; id < build.states_count; id++)
+		{
+			for (uint32_t cls = 0; cls < build.classes_count; cls++)
+			{
+				const char c = representatives[cls];
+				uint64_t next[Build::words_count] = {};
+				int32_t accept = -1;
+				for (uint32_t word = 0; word < Build::words_count; word++)
+				{
+					for (uint64_t bits = build.states[id][word]; bits != 0; bits &= bits - 1)
+					{
+						const uint32_t position = word * 64 + _priv::static_trailing_zeros64(bits);
+						const uint32_t p = position_pattern[position];
+						const StaticTokenPattern& pattern = tree.getPatternAt(p);
+
+						// Possessive step, as in compile().
+						uint32_t element = position_element[position];
+						uint32_t offset = position_offset[position];
+						while (element < pattern.lexemes_count)
+						{
+							const char* lexeme = pattern.lexemes[element];
+							if (lexeme[0] == '$')
+							{
+								if (_priv::static_contains(lexeme + 1, c))
+								{
+									const uint32_t target = element_positions[p][element];
+									next[target / 64] |= uint64_t(1) << (target % 64);
+									break;
+								}
+								element++;
+								continue;
+							}
+							const uint32_t length = _priv::static_length(lexeme);
+							if (length == 0)
+							{
+								element++;
+								continue;
+							}
+							if (lexeme[offset] == c)
+							{
+								if (++offset == length)
+								{
+									element++;
+									offset = 0;
+								}
+								const uint32_t target = element_positions[p][element] + offset;
+								next[target / 64] |= uint64_t(1) << (target % 64);
+							}
+							break;
+						}
+
+						if (!_priv::is_terminator(c) || position_offset[position] != 0)
+						{
+							continue;
+						}
+						bool accepted = true;
+						for (uint32_t e = position_element[position]; e < pattern.lexemes_count && accepted; e++)
+						{
+							const char* lexeme = pattern.lexemes[e];
+							const bool expression = lexeme[0] == '$';
+							const uint32_t length = _priv::static_length(expression ? lexeme + 1 : lexeme);
+							accepted = length == 0 || (expression && !_priv::static_contains(lexeme + 1, c));
+						}
+						if (accepted && (accept < 0 ||
+							pattern.lexemes_count > tree.getPatternAt(static_cast<uint32_t>(accept)).lexemes_count))
+						{
+							accept = static_cast<int32_t>(p);
+						}
+					}
+				}
+
+				uint32_t target = 0;
+				while (target < build.states_count)
+				{
+					bool same = true;
+					for (uint32_t w = 0; w < Build::words_count && same; w++)
+					{
+						same = build.states[target][w] == next[w];
+					}
+					if (same)
+					{
+						break;
+					}
+					target++;
+				}
+				if (target == build.states_count)
+				{
+					if (build.states_count == _States)
+					{
+						build.overflow = true;
+						return build;
+					}
+					for (uint32_t w = 0; w < Build::words_count; w++)
+					{
+						build.states[target][w] = next[w];
+					}
+					build.states_count++;
+				}
+				build.transitions[id * build.classes_count + cls] = target;
+				build.accepts[id * build.classes_count + cls] = accept;
+			}
+		}
+		return build;
+	}
+
+	// The tables of a DefinitionTokenStructureAutomaton for the patterns of
+	// _Tree, computed while the program is compiled. They sit in read-only
+	// data: startup builds and allocates nothing, and every process running
+	// the binary shares the pages through the page cache.
+	template <const auto& _Tree, uint32_t _States = 128, uint32_t _Classes = 32, uint32_t _Positions = 512>
+	class StaticAutomaton
+	{
+		static constexpr auto build = buildStaticAutomaton<_States, _Classes, _Positions>(_Tree);
+		static_assert(!build.overflow, "the tree needs more _States, _Classes or _Positions");
+
+		template <typename _Type, uint32_t _Count>
+		static constexpr std::array<_Type, _Count> copy(const _Type* source)
+		{
+			std::array<_Type, _Count> table = {};
+			for (uint32_t i = 0; i < _Count; i++)
+			{
+				table[i] = source[i];
+			}
+			return table;
+		}
+
+		static constexpr std::array<DefinitionTokenStructureAutomaton::AcceptState, _Tree.getPatternsCount()> makeAcceptStates()
+		{
+			std::array<DefinitionTokenStructureAutomaton::AcceptState, _Tree.getPatternsCount()> accept_states = {};
+			for (uint32_t i = 0; i < _Tree.getPatternsCount(); i++)
+			{
+				accept_states[i] = { _Tree.getPatternAt(i).user_data, _Tree.getPatternAt(i).lexemes_count };
+			}
+			return accept_states;
+		}
+
+	public:
+		static constexpr uint32_t classes_count = build.classes_count;
+		static constexpr uint32_t states_count = build.states_count;
+		static constexpr uint32_t cells_count = states_count * classes_count;
+
+		static constexpr std::array<uint8_t, 256> byte_classes = copy<uint8_t, 256>(build.byte_classes);
+		static constexpr std::array<uint32_t, cells_count> transitions = copy<uint32_t, cells_count>(build.transitions);
+		static constexpr std::array<int32_t, cells_count> accepts = copy<int32_t, cells_count>(build.accepts);
+		static constexpr std::array<DefinitionTokenStructureAutomaton::AcceptState, _Tree.getPatternsCount()> accept_states =
+			makeAcceptStates();
+
+		static void assign(DefinitionTokenStructureAutomaton& automaton)
+		{
+			automaton.assign(
+				byte_classes.data(),
+				classes_count,
+				states_count,
+				transitions.data(),
+				accepts.data(),
+				accept_states.data(),
+				static_cast<uint32_t>(accept_states.size())
+			);
+		}
+	};
+
+	// Points automata at the built-in tables; the result is in ETokenKind
+	// order.
+	inline TokenAutomata assignBuiltinAutomata(DefinitionTokenStructureAutomaton (&automata)[token_trees_count])
+	{
+		StaticAutomaton<builtin_tree_type>::assign(automata[static_cast<uint32_t>(ETokenKind::Type)]);
+		StaticAutomaton<builtin_tree_numeric>::assign(automata[static_cast<uint32_t>(ETokenKind::Numeric)]);
+		StaticAutomaton<builtin_tree_assignment>::assign(automata[static_cast<uint32_t>(ETokenKind::Assignment)]);
+		StaticAutomaton<builtin_tree_semicolon>::assign(automata[static_cast<uint32_t>(ETokenKind::Semicolon)]);
+		StaticAutomaton<builtin_tree_bkt_figure_open>::assign(automata[static_cast<uint32_t>(ETokenKind::BktFigureOpen)]);
+		StaticAutomaton<builtin_tree_bkt_figure_close>::assign(automata[static_cast<uint32_t>(ETokenKind::BktFigureClose)]);
+		StaticAutomaton<builtin_tree_variable_name>::assign(automata[static_cast<uint32_t>(ETokenKind::VariableName)]);
+		TokenAutomata pointers;
+		for (uint32_t i = 0; i < token_trees_count; i++)
+		{
+			pointers[i] = &automata[i];
+		}
+		return pointers;
+	}
+}
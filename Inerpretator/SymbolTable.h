@@ -0,0 +1,220 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "deftok.h"
+
+
+namespace prs
+{
+	namespace _priv
+	{
+		constexpr uint32_t symbol_hash_seed = 2166136261u;
+
+		// FNV-1a, one byte at a time, so the lexer can fold it into the
+		// loop that finds the end of the identifier.
+		inline constexpr uint32_t __fastcall hash_step(const uint32_t hash, const char c)
+		{
+			return (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+		}
+
+		inline bool __fastcall is_identifier(const char c)
+		{
+			return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+		}
+	}
+
+	enum class EKeyword : uint8_t
+	{
+		None,
+		Const,
+		Int,
+		Float,
+		Double,
+		Long
+	};
+
+	namespace _priv
+	{
+		struct KeywordEntry
+		{
+			const char* chars;
+			uint32_t length;
+			EKeyword keyword;
+		};
+
+		constexpr KeywordEntry keywords[] = {
+			{ "const", 5, EKeyword::Const },
+			{ "int", 3, EKeyword::Int },
+			{ "float", 5, EKeyword::Float },
+			{ "double", 6, EKeyword::Double },
+			{ "long", 4, EKeyword::Long }
+		};
+
+		constexpr uint32_t keyword_table_size = 8;
+
+		// First and last byte are enough to tell the keywords apart.
+		inline constexpr uint32_t __fastcall keyword_hash(const char first, const char last)
+		{
+			return (static_cast<uint8_t>(first) + static_cast<uint8_t>(last)) & (keyword_table_size - 1);
+		}
+
+		struct KeywordTable
+		{
+			KeywordEntry slots[keyword_table_size];
+			bool perfect;
+		};
+
+		inline constexpr KeywordTable __fastcall make_keyword_table()
+		{
+			KeywordTable table = {};
+			table.perfect = true;
+			for (const KeywordEntry& entry : keywords)
+			{
+				KeywordEntry& slot = table.slots[keyword_hash(entry.chars[0], entry.chars[entry.length - 1])];
+				table.perfect = table.perfect && slot.keyword == EKeyword::None;
+				slot = entry;
+			}
+			return table;
+		}
+
+		constexpr KeywordTable keyword_table = make_keyword_table();
+		static_assert(keyword_table.perfect, "keyword_hash collides;");
+	}
+
+	inline EKeyword __fastcall findKeyword(const char* chars, const uint32_t length)
+	{
+		if (length == 0)
+		{
+			return EKeyword::None;
+		}
+		const _priv::KeywordEntry& slot = _priv::keyword_table.slots[_priv::keyword_hash(chars[0], chars[length - 1])];
+		if (slot.length == length && memcmp(slot.chars, chars, length) == 0)
+		{
+			return slot.keyword;
+		}
+		return EKeyword::None;
+	}
+
+	// Interns identifier spans into dense ids 0, 1, 2, ... in order of first
+	// appearance. Open addressing with linear probing; the slot keeps the
+	// full hash so most mismatches never touch the text.
+	class SymbolTable
+	{
+	public:
+		static constexpr uint32_t invalid_symbol = 0xFFFFFFFF;
+
+		SymbolTable()
+		{
+			m_slots.assign(initial_slots_count, Slot{ 0, invalid_symbol });
+		}
+
+		static uint32_t hash(const char* chars, const uint32_t length)
+		{
+			uint32_t hash = _priv::symbol_hash_seed;
+			for (uint32_t i = 0; i < length; i++)
+			{
+				hash = _priv::hash_step(hash, chars[i]);
+			}
+			return hash;
+		}
+
+		uint32_t intern(const char* chars, const uint32_t length)
+		{
+			return this->intern(chars, length, hash(chars, length));
+		}
+
+		// hash must be SymbolTable::hash(chars, length).
+		uint32_t intern(const char* chars, const uint32_t length, const uint32_t hash)
+		{
+			const size_t mask = m_slots.size() - 1;
+			size_t index = hash & mask;
+			while (m_slots[index].symbol != invalid_symbol)
+			{
+				const Slot& slot = m_slots[index];
+				if (slot.hash == hash && this->equals(slot.symbol, chars, length))
+				{
+					return slot.symbol;
+				}
+				index = (index + 1) & mask;
+			}
+
+			const uint32_t symbol = static_cast<uint32_t>(m_symbols.size());
+			m_symbols.push_back({ static_cast<uint32_t>(m_chars.size()), length });
+			m_chars.insert(m_chars.end(), chars, chars + length);
+			m_slots[index] = { hash, symbol };
+			if ((m_symbols.size() + 1) * 2 > m_slots.size())
+			{
+				this->grow();
+			}
+			return symbol;
+		}
+
+		const char* getChars(const uint32_t symbol) const
+		{
+			return m_chars.data() + m_symbols[symbol].offset;
+		}
+
+		uint32_t getLength(const uint32_t symbol) const
+		{
+			return m_symbols[symbol].length;
+		}
+
+		uint32_t getSymbolsCount() const
+		{
+			return static_cast<uint32_t>(m_symbols.size());
+		}
+
+		void clear()
+		{
+			m_slots.assign(initial_slots_count, Slot{ 0, invalid_symbol });
+			m_symbols.clear();
+			m_chars.clear();
+		}
+
+	private:
+		static constexpr size_t initial_slots_count = 64;
+
+		struct Slot
+		{
+			uint32_t hash;
+			uint32_t symbol;
+		};
+
+		struct Symbol
+		{
+			uint32_t offset;
+			uint32_t length;
+		};
+
+		bool equals(const uint32_t symbol, const char* chars, const uint32_t length) const
+		{
+			return m_symbols[symbol].length == length
+				&& memcmp(m_chars.data() + m_symbols[symbol].offset, chars, length) == 0;
+		}
+
+		void grow()
+		{
+			std::vector<Slot> slots(m_slots.size() * 2, Slot{ 0, invalid_symbol });
+			const size_t mask = slots.size() - 1;
+			for (const Slot& slot : m_slots)
+			{
+				if (slot.symbol == invalid_symbol)
+				{
+					continue;
+				}
+				size_t index = slot.hash & mask;
+				while (slots[index].symbol != invalid_symbol)
+				{
+					index = (index + 1) & mask;
+				}
+				slots[index] = slot;
+			}
+			m_slots.swap(slots);
+		}
+
+		std::vector<Slot> m_slots;
+		std::vector<Symbol> m_symbols;
+		std::vector<char> m_chars;
+	};
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+
+namespace prs
+{
+	// Fixed set of workers, one task deque each. A worker takes from the
+	// back of its own deque and, when that is empty, steals from the front
+	// of the others, so uneven tasks spread out without a shared queue.
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(const size_t threads_count = defaultThreadsCount()) :
+			m_queues(new Queue[threads_count != 0 ? threads_count : 1]),
+			m_queues_count(threads_count != 0 ? threads_count : 1)
+		{
+			m_threads.reserve(m_queues_count);
+			for (size_t i = 0; i < m_queues_count; i++)
+			{
+				m_threads.emplace_back([this, i]() { this->work(i); });
+			}
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator = (const ThreadPool&) = delete;
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			for (std::thread& thread : m_threads)
+			{
+				thread.join();
+			}
+		}
+
+		static size_t defaultThreadsCount()
+		{
+			const unsigned int count = std::thread::hardware_concurrency();
+			return count != 0 ? count : 1;
+		}
+
+		size_t getThreadsCount() const
+		{
+			return m_queues_count;
+		}
+
+		// Calls function(index, worker) for every index in [0, count) and
+		// returns when all calls are done. worker is in [0, getThreadsCount())
+		// and no two concurrent calls share it.
+		template <typename _Function>
+		void parallelFor(const size_t count, const _Function& function)
+		{
+			if (count == 0)
+			{
+				return;
+			}
+			Batch batch;
+			batch.remaining = count;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_queued += count;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				Queue& queue = m_queues[i % m_queues_count];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				queue.tasks.push_back({ &invoke<_Function>, &function, i, &batch });
+			}
+			m_wake.notify_all();
+
+			std::unique_lock<std::mutex> lock(batch.mutex);
+			batch.done.wait(lock, [&batch]() { return batch.remaining == 0; });
+		}
+
+	private:
+		struct Batch
+		{
+			std::mutex mutex;
+			std::condition_variable done;
+			size_t remaining = 0;
+		};
+
+		struct Task
+		{
+			void (*call)(const void* function, size_t index, size_t worker);
+			const void* function;
+			size_t index;
+			Batch* batch;
+		};
+
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		template <typename _Function>
+		static void invoke(const void* function, const size_t index, const size_t worker)
+		{
+			(*static_cast<const _Function*>(function))(index, worker);
+		}
+
+		bool take(const size_t worker, Task& task)
+		{
+			for (size_t i = 0; i < m_queues_count; i++)
+			{
+				Queue& queue = m_queues[(worker + i) % m_queues_count];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				if (queue.tasks.empty())
+				{
+					continue;
+				}
+				if (i == 0)
+				{
+					task = queue.tasks.back();
+					queue.tasks.pop_back();
+				}
+				else
+				{
+					task = queue.tasks.front();
+					queue.tasks.pop_front();
+				}
+				return true;
+			}
+			return false;
+		}
+
+		void work(const size_t worker)
+		{
+			while (true)
+			{
+				Task task;
+				if (!this->take(worker, task))
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_wake.wait(lock, [this]() { return m_stop || m_queued != 0; });
+					if (m_stop && m_queued == 0)
+					{
+						return;
+					}
+					continue;
+				}
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_queued--;
+				}
+				task.call(task.function, task.index, worker);
+
+				// The batch lives on the caller's stack: it may only be
+				// released once this lock is gone.
+				std::lock_guard<std::mutex> lock(task.batch->mutex);
+				if (--task.batch->remaining == 0)
+				{
+					task.batch->done.notify_all();
+				}
+			}
+		}
+
+		std::unique_ptr<Queue[]> m_queues;
+		const size_t m_queues_count;
+		std::vector<std::thread> m_threads;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		size_t m_queued = 0;
+		bool m_stop = false;
+	};
+}
@@ -0,0 +1,321 @@
+#pragma once
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include "Lexer.h"
+#include "Numeric.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PRS_COMPUTED_GOTO
+#endif
+
+
+namespace prs
+{
+	enum class EOpcode : uint8_t
+	{
+		Halt,
+		LoadConstant,
+		SIntToSLong,
+		SIntToFloat,
+		SIntToDouble,
+		FloatToSInt,
+		FloatToSLong,
+		FloatToDouble,
+		DoubleToSInt,
+		DoubleToSLong,
+		DoubleToFloat
+	};
+
+	// 8 bytes: opcode and destination register share the first word.
+	struct Instruction
+	{
+		uint32_t opcode : 8;
+		uint32_t a : 24;
+		uint32_t b;
+	};
+
+	union RegisterValue
+	{
+		int32_t s_int;
+		int64_t s_long;
+		float f;
+		double d;
+		uint64_t bits;
+	};
+
+	struct BytecodeVariable
+	{
+		std::string name;
+		ENumericTypeTraits type;
+		uint32_t reg;
+	};
+
+	struct BytecodeProgram
+	{
+		std::vector<Instruction> code;
+		std::vector<RegisterValue> constants;
+		std::vector<BytecodeVariable> variables;
+		uint32_t registers_count = 0;
+	};
+
+	// Lowers recognised `type name = numeric ;` declarations. Every variable
+	// owns a register typed by its declaration; the literal is loaded from
+	// the constant pool in its own type and converted in place if needed.
+	// Variables are told apart by the symbol id the lexer stored in the
+	// VariableName token.
+	class BytecodeCompiler
+	{
+	public:
+		bool compile(
+			const char* content,
+			const TokenBuffer& tokens,
+			const std::vector<size_t>& declarations,
+			BytecodeProgram& program
+		)
+		{
+			constexpr uint32_t type_mask = 0xF0000000;
+			m_variables.clear();
+			bool success = true;
+			for (const size_t index : declarations)
+			{
+				const ENumericTypeTraits type = static_cast<ENumericTypeTraits>(tokens.getUserData(index) & type_mask);
+				const size_t name_index = index + 1;
+				const size_t numeric_index = index + 3;
+
+				NumericValue literal;
+				if (!convertNumeric(
+					content + tokens.getOffset(numeric_index),
+					tokens.getLength(numeric_index),
+					tokens.getUserData(numeric_index),
+					literal,
+					type == ENumericTypeTraits::SLong ? ENumericTypeTraits::SLong : ENumericTypeTraits::SInt) || !representable(literal, type))
+				{
+					success = false;
+					continue;
+				}
+
+				const uint32_t symbol = tokens.getUserData(name_index);
+				if (symbol >= m_variables.size())
+				{
+					m_variables.resize(symbol + 1, invalid_variable);
+				}
+				if (m_variables[symbol] == invalid_variable)
+				{
+					m_variables[symbol] = static_cast<uint32_t>(program.variables.size());
+					program.variables.push_back({
+						std::string(content + tokens.getOffset(name_index), tokens.getLength(name_index)),
+						type,
+						program.registers_count++
+					});
+				}
+				BytecodeVariable& variable = program.variables[m_variables[symbol]];
+				variable.type = type;
+
+				RegisterValue constant;
+				constant.bits = 0;
+				switch (literal.type)
+				{
+				case ENumericTypeTraits::Float:
+					constant.f = literal.f;
+					break;
+				case ENumericTypeTraits::Double:
+					constant.d = literal.d;
+					break;
+				case ENumericTypeTraits::SLong:
+					constant.s_long = literal.s_long;
+					break;
+				default:
+					constant.s_int = literal.s_int;
+					break;
+				}
+				program.code.push_back(instruction(EOpcode::LoadConstant, variable.reg, static_cast<uint32_t>(program.constants.size())));
+				program.constants.push_back(constant);
+
+				const EOpcode conversion = this->conversion(literal.type, type);
+				if (conversion != EOpcode::Halt)
+				{
+					program.code.push_back(instruction(conversion, variable.reg, variable.reg));
+				}
+			}
+			program.code.push_back(instruction(EOpcode::Halt, 0, 0));
+			return success;
+		}
+
+	private:
+		static constexpr uint32_t invalid_variable = 0xFFFFFFFF;
+
+		static Instruction instruction(const EOpcode opcode, const uint32_t a, const uint32_t b)
+		{
+			Instruction result;
+			result.opcode = static_cast<uint32_t>(opcode);
+			result.a = a;
+			result.b = b;
+			return result;
+		}
+
+		// A literal must keep its value in the declared type: a float becomes
+		// an integer only when it has no fraction and fits, and a double a
+		// float only within the float range. The grammar has no spelling for
+		// infinity, so an infinite literal overflowed its own type. Integer
+		// literals are read in the declared width, or as SInt for a float
+		// target, which every int32 fits.
+		static bool representable(const NumericValue& literal, const ENumericTypeTraits to)
+		{
+			if (literal.type == ENumericTypeTraits::SInt || literal.type == ENumericTypeTraits::SLong)
+			{
+				return true;
+			}
+			const double value = literal.type == ENumericTypeTraits::Float ? static_cast<double>(literal.f) : literal.d;
+			if (!std::isfinite(value))
+			{
+				return false;
+			}
+			switch (to)
+			{
+			case ENumericTypeTraits::SInt:
+				return value >= -2147483648.0 && value <= 2147483647.0 && std::trunc(value) == value;
+			case ENumericTypeTraits::SLong:
+				return value >= -9223372036854775808.0 && value < 9223372036854775808.0 && std::trunc(value) == value;
+			case ENumericTypeTraits::Float:
+				return std::fabs(value) <= static_cast<double>(std::numeric_limits<float>::max());
+			default:
+				return true;
+			}
+		}
+
+		// Halt stands for "no conversion needed".
+		static EOpcode conversion(const ENumericTypeTraits from, const ENumericTypeTraits to)
+		{
+			if (from == to)
+			{
+				return EOpcode::Halt;
+			}
+			switch (from)
+			{
+			case ENumericTypeTraits::SInt:
+				return to == ENumericTypeTraits::SLong ? EOpcode::SIntToSLong
+					: to == ENumericTypeTraits::Float ? EOpcode::SIntToFloat : EOpcode::SIntToDouble;
+			case ENumericTypeTraits::Float:
+				return to == ENumericTypeTraits::SLong ? EOpcode::FloatToSLong
+					: to == ENumericTypeTraits::SInt ? EOpcode::FloatToSInt : EOpcode::FloatToDouble;
+			default:
+				return to == ENumericTypeTraits::SLong ? EOpcode::DoubleToSLong
+					: to == ENumericTypeTraits::SInt ? EOpcode::DoubleToSInt : EOpcode::DoubleToFloat;
+			}
+		}
+
+		std::vector<uint32_t> m_variables;
+	};
+
+	class VirtualMachine
+	{
+	public:
+		// Returns the number of instructions executed, Halt included.
+		uint64_t run(const BytecodeProgram& program)
+		{
+			m_registers.assign(program.registers_count, RegisterValue());
+			const Instruction* const code = program.code.data();
+			const Instruction* ip = code;
+			RegisterValue* const r = m_registers.data();
+			const RegisterValue* const k = program.constants.data();
+
+#if defined(PRS_COMPUTED_GOTO)
+			static const void* const labels[] = {
+				&&op_Halt,
+				&&op_LoadConstant,
+				&&op_SIntToSLong,
+				&&op_SIntToFloat,
+				&&op_SIntToDouble,
+				&&op_FloatToSInt,
+				&&op_FloatToSLong,
+				&&op_FloatToDouble,
+				&&op_DoubleToSInt,
+				&&op_DoubleToSLong,
+				&&op_DoubleToFloat
+			};
+#define PRS_VM_BEGIN() goto *labels[ip->opcode];
+#define PRS_VM_OP(name) op_##name:
+#define PRS_VM_NEXT() goto *labels[(++ip)->opcode]
+#define PRS_VM_END()
+#else
+#define PRS_VM_BEGIN() for (;;) { switch (static_cast<EOpcode>(ip->opcode)) {
+#define PRS_VM_OP(name) case EOpcode::name:
+#define PRS_VM_NEXT() ++ip; continue
+#define PRS_VM_END() } }
+#endif
+
+			PRS_VM_BEGIN()
+			PRS_VM_OP(Halt)
+			{
+				return static_cast<uint64_t>(ip - code) + 1;
+			}
+			PRS_VM_OP(LoadConstant)
+			{
+				r[ip->a] = k[ip->b];
+				PRS_VM_NEXT();
+			}
+			PRS_VM_OP(SIntToSLong)
+			{
+				r[ip->a].s_long = static_cast<int64_t>(r[ip->b].s_int);
+				PRS_VM_NEXT();
+			}
+			PRS_VM_OP(SIntToFloat)
+			{
+				r[ip->a].f = static_cast<float>(r[ip->b].s_int);
+				PRS_VM_NEXT();
+			}
+			PRS_VM_OP(SIntToDouble)
+			{
+				r[ip->a].d = static_cast<double>(r[ip->b].s_int);
+				PRS_VM_NEXT();
+			}
+			PRS_VM_OP(FloatToSInt)
+			{
+				r[ip->a].s_int = static_cast<int32_t>(r[ip->b].f);
+				PRS_VM_NEXT();
+			}
+			PRS_VM_OP(FloatToSLong)
+			{
+				r[ip->a].s_long = static_cast<int64_t>(r[ip->b].f);
+				PRS_VM_NEXT();
+			}
+			PRS_VM_OP(FloatToDouble)
+			{
+				r[ip->a].d = static_cast<double>(r[ip->b].f);
+				PRS_VM_NEXT();
+			}
+			PRS_VM_OP(DoubleToSInt)
+			{
+				r[ip->a].s_int = static_cast<int32_t>(r[ip->b].d);
+				PRS_VM_NEXT();
+			}
+			PRS_VM_OP(DoubleToSLong)
+			{
+				r[ip->a].s_long = static_cast<int64_t>(r[ip->b].d);
+				PRS_VM_NEXT();
+			}
+			PRS_VM_OP(DoubleToFloat)
+			{
+				r[ip->a].f = static_cast<float>(r[ip->b].d);
+				PRS_VM_NEXT();
+			}
+			PRS_VM_END()
+
+#undef PRS_VM_BEGIN
+#undef PRS_VM_OP
+#undef PRS_VM_NEXT
+#undef PRS_VM_END
+			return 0;
+		}
+
+		const RegisterValue& getRegister(const uint32_t index) const
+		{
+			return m_registers[index];
+		}
+
+	private:
+		std::vector<RegisterValue> m_registers;
+	};
+}
@@ -1 +1,1789 @@
 #pragma once
+#include <map>
+#include <string>
+#include <iostream>
+#include <vector>
+#include <type_traits>
+#include <algorithm>
+#include "CharacterSet.h"
+#include "MatchStats.h"
+#include "ParserArena.h"
+
+
+namespace prs
+{
+	namespace _priv
+	{
+		// Every ASCII whitespace byte; '\r' so CRLF text lexes like LF text.
+		inline constexpr bool __fastcall is_space(const char c)
+		{
+			return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+		}
+
+		inline const CharacterSet trivia_space(" \t\n\r\v\f");
+
+		inline const CharacterSet trivia_line_comment = []()
+		{
+			CharacterSet set;
+			for (uint32_t c = 1; c < 256; c++)
+			{
+				if (c != '\n')
+				{
+					set.add(static_cast<char>(c));
+				}
+			}
+			return set;
+		}();
+
+		inline const CharacterSet trivia_block_comment = []()
+		{
+			CharacterSet set;
+			for (uint32_t c = 1; c < 256; c++)
+			{
+				if (c != '*')
+				{
+					set.add(static_cast<char>(c));
+				}
+			}
+			return set;
+		}();
+
+		// Skips whitespace, `//` comments up to the end of the line and
+		// `/* */` comments, 16 or 32 bytes at a time. Like a token, a comment
+		// only starts after trivia. Without content_end the text ends at
+		// its '\0' sentinel; with it, a '\0' before content_end is text.
+		// Returns false if the text ends inside a block comment; a line
+		// comment may run to the end.
+		inline bool __fastcall skip_trivia(const char** ptr_content, const char* content_end)
+		{
+			const char* content = *ptr_content;
+			auto at_end = [content_end](const char* position)
+			{
+				return content_end != nullptr ? position >= content_end : *position == '\0';
+			};
+			bool closed = true;
+			while (true)
+			{
+				content += trivia_space.span(content);
+				if (content_end != nullptr && content > content_end)
+				{
+					content = content_end;
+				}
+				if (at_end(content) || content[0] != '/' || (content[1] != '*' && content[1] != '/') || at_end(content + 1))
+				{
+					break;
+				}
+				const CharacterSet& body = content[1] == '*' ? trivia_block_comment : trivia_line_comment;
+				const bool block = content[1] == '*';
+				content += 2;
+				closed = !block;
+				while (true)
+				{
+					content += body.span(content);
+					if (at_end(content))
+					{
+						break;
+					}
+					if (*content == '\0')
+					{
+						content++;
+						continue;
+					}
+					if (!block)
+					{
+						closed = true;
+						break;
+					}
+					if (content[1] == '/' && !at_end(content + 1))
+					{
+						content += 2;
+						closed = true;
+						break;
+					}
+					content++;
+				}
+				if (!closed)
+				{
+					if (content_end != nullptr)
+					{
+						content = content_end;
+					}
+					break;
+				}
+			}
+			*ptr_content = content;
+			return closed;
+		}
+
+		inline void __fastcall skip_space(const char** ptr_content)
+		{
+			skip_trivia(ptr_content, nullptr);
+		}
+
+		inline constexpr bool __fastcall is_terminator(const char c)
+		{
+			return c == '\0' || is_space(c);
+		}
+
+		// `;` and `}` end statements, so an unknown span must not swallow
+		// them: panic-mode recovery resynchronises on them.
+		inline constexpr bool __fastcall ends_unknown(const char c)
+		{
+			return is_terminator(c) || c == ';' || c == '}';
+		}
+	}
+
+	template <typename _FlagU32>
+	inline constexpr const uint32_t __fastcall make_flag(_FlagU32 flag)
+	{
+		static_assert(
+			std::is_arithmetic_v<_FlagU32> || std::is_enum_v<_FlagU32>, 
+			"_FlagU32 is not arithmetic type;"
+			"_FlagU32 is not enum type;"
+			);
+		return static_cast<uint32_t>(flag);
+	}
+
+	template <typename _FlagU32, typename... _FlagsU32>
+	inline constexpr const uint32_t __fastcall make_flag(_FlagU32 flag, _FlagsU32... flags)
+	{
+		static_assert(
+			std::is_arithmetic_v<_FlagU32> || std::is_enum_v<_FlagU32>,
+			"_FlagU32 is not arithmetic type;"
+			"_FlagU32 is not enum type;"
+			);
+		return static_cast<uint32_t>(flag) | make_flag<_FlagsU32...>(flags...);
+	}
+
+	template <typename _CompU32, typename _FlagU32>
+	inline constexpr const bool __fastcall comp_flag(
+		_CompU32 comp, 
+		uint32_t ignore_mask, 
+		_FlagU32 flag
+	)
+	{
+		static_assert(
+			(std::is_arithmetic_v<_FlagU32> || std::is_enum_v<_FlagU32>) &&
+			(std::is_arithmetic_v<_CompU32> || std::is_enum_v<_CompU32>),
+			"_FlagU32 is not arithmetic type;"
+			"_FlagU32 is not enum type;"
+			"_CompU32 is not arithmetic type;"
+			"_CompU32 is not enum type;"
+			);
+		return ((static_cast<uint32_t>(comp) & ignore_mask) == (static_cast<uint32_t>(flag)));
+	}
+
+	template <typename _CompU32, typename _FlagU32, typename... _FlagsU32>
+	inline constexpr const bool __fastcall comp_flag(
+		_CompU32 comp, 
+		uint32_t ignore_mask, 
+		_FlagU32 flag,  
+		_FlagsU32... flags
+	)
+	{
+		static_assert(
+			(std::is_arithmetic_v<_FlagU32> || std::is_enum_v<_FlagU32>) && 
+			(std::is_arithmetic_v<_CompU32> || std::is_enum_v<_CompU32>),
+			"_FlagU32 is not arithmetic type;"
+			"_FlagU32 is not enum type;"
+			"_CompU32 is not arithmetic type;"
+			"_CompU32 is not enum type;"
+			);
+		return ((static_cast<uint32_t>(comp) & ignore_mask) == (static_cast<uint32_t>(flag)))
+			&& comp_flag(comp, flags...);
+	}
+
+	enum class EDefinitionTraits : uint32_t
+	{
+		Numric,
+		Character,
+		String,
+		Array,
+		Expression
+	};
+
+	enum class ENumericTypeTraits : uint32_t
+	{
+		SChar =		0x10000000,
+		UChar =		0x20000000,
+		SShort =	0x30000000,
+		UShort =	0x40000000,
+		SInt =		0x50000000,
+		UInt =		0x60000000,
+		Float =		0x70000000,
+		SLong =		0x80000000,
+		ULong =		0x90000000,
+		SLLong =	0xA0000000,
+		ULLong =	0xB0000000,
+		Double =	0xC0000000,
+	};
+
+	constexpr uint32_t static_lexemes_capacity = 8;
+
+	// A pattern as DefinitionTokenStructure reads it: lexemes that start
+	// with '$' are expressions over the bytes that follow.
+	struct StaticTokenPattern
+	{
+		uint32_t user_data;
+		uint32_t lexemes_count;
+		const char* lexemes[static_lexemes_capacity];
+	};
+
+	// The patterns of one tree as a constant: add() returns a copy with the
+	// pattern appended, so a whole tree is one constexpr expression. Going
+	// past _Capacity is an out-of-bounds write, which no constant
+	// expression may contain, so it fails to compile.
+	template <uint32_t _Capacity>
+	class StaticTokenTree
+	{
+	public:
+		template <typename... _String_lexemes>
+		constexpr StaticTokenTree add(const uint32_t user_data, _String_lexemes... lexemes) const
+		{
+			static_assert(sizeof...(_String_lexemes) >= 1 && sizeof...(_String_lexemes) <= static_lexemes_capacity);
+			const char* const list[] = { lexemes... };
+			StaticTokenTree tree = *this;
+			StaticTokenPattern& pattern = tree.m_patterns[tree.m_count++];
+			pattern.user_data = user_data;
+			pattern.lexemes_count = sizeof...(_String_lexemes);
+			for (uint32_t i = 0; i < sizeof...(_String_lexemes); i++)
+			{
+				pattern.lexemes[i] = list[i];
+			}
+			return tree;
+		}
+
+		constexpr uint32_t getPatternsCount() const
+		{
+			return m_count;
+		}
+
+		constexpr const StaticTokenPattern& getPatternAt(const uint32_t index) const
+		{
+			return m_patterns[index];
+		}
+
+	private:
+		StaticTokenPattern m_patterns[_Capacity] = {};
+		uint32_t m_count = 0;
+	};
+
+	// The built-in grammar. DefinitionTokenStructureDictionaryTrees builds
+	// its trees from these; StaticAutomaton.h compiles them into tables
+	// while the program itself is compiled.
+	inline constexpr auto builtin_tree_bkt_figure_open = StaticTokenTree<1>()
+		.add(0, "{");
+
+	inline constexpr auto builtin_tree_bkt_figure_close = StaticTokenTree<1>()
+		.add(0, "}");
+
+	inline constexpr auto builtin_tree_assignment = StaticTokenTree<1>()
+		.add(0, "=");
+
+	inline constexpr auto builtin_tree_semicolon = StaticTokenTree<1>()
+		.add(0, ";");
+
+	inline constexpr auto builtin_tree_variable_name = StaticTokenTree<1>()
+		.add(0, "$_qwertyuiopasdfghjklzxcvbnmQWERTYUIOPASDFGHJKLZXCVBNM1234567890");
+
+	inline constexpr auto builtin_tree_type = StaticTokenTree<4>()
+		.add(make_flag(ENumericTypeTraits::SInt), "const", "$ ", "int")
+		.add(make_flag(ENumericTypeTraits::Float), "const", "$ ", "float")
+		.add(make_flag(ENumericTypeTraits::Double), "const", "$ ", "double")
+		.add(make_flag(ENumericTypeTraits::SLong), "const", "$ ", "long");
+
+	inline constexpr auto builtin_tree_numeric = []()
+	{
+		constexpr uint32_t float_type_flag = make_flag(ENumericTypeTraits::Float);
+		constexpr uint32_t double_type_flag = make_flag(ENumericTypeTraits::Double);
+		constexpr uint32_t int_type_flag = make_flag(ENumericTypeTraits::SInt);
+		return StaticTokenTree<48>()
+			.add(float_type_flag, "+", "$0123456789", ".", "$0123456789", "f")
+			.add(float_type_flag, "+", "$0123456789", ".", "$0123456789", "F")
+			.add(float_type_flag, "+", "$0123456789", ".", "f")
+			.add(float_type_flag, "+", "$0123456789", ".", "F")
+			.add(float_type_flag, "-", "$0123456789", ".", "$0123456789", "f")
+			.add(float_type_flag, "-", "$0123456789", ".", "$0123456789", "F")
+			.add(float_type_flag, "-", "$0123456789", ".", "f")
+			.add(float_type_flag, "-", "$0123456789", ".", "F")
+			.add(float_type_flag, "$0123456789", ".", "$0123456789", "f")
+			.add(float_type_flag, "$0123456789", ".", "$0123456789", "F")
+			.add(float_type_flag, "$0123456789", ".", "f")
+			.add(float_type_flag, "$0123456789", ".", "F")
+			.add(float_type_flag, "-", ".", "$0123456789", "f")
+			.add(float_type_flag, "-", ".", "$0123456789", "F")
+			.add(float_type_flag, "+", ".", "$0123456789", "f")
+			.add(float_type_flag, "+", ".", "$0123456789", "F")
+			.add(float_type_flag, ".", "$0123456789", "f")
+			.add(float_type_flag, ".", "$0123456789", "F")
+			.add(int_type_flag, "+", "$0123456789")
+			.add(int_type_flag, "-", "$0123456789")
+			.add(int_type_flag, "$0123456789")
+			.add(double_type_flag, "+", "$0123456789", ".", "$0123456789", "d")
+			.add(double_type_flag, "+", "$0123456789", ".", "$0123456789", "D")
+			.add(double_type_flag, "+", "$0123456789", ".", "d")
+			.add(double_type_flag, "+", "$0123456789", ".", "D")
+			.add(double_type_flag, "-", "$0123456789", ".", "$0123456789", "d")
+			.add(double_type_flag, "-", "$0123456789", ".", "$0123456789", "D")
+			.add(double_type_flag, "-", "$0123456789", ".", "d")
+			.add(double_type_flag, "-", "$0123456789", ".", "D")
+			.add(double_type_flag, "$0123456789", ".", "$0123456789", "d")
+			.add(double_type_flag, "$0123456789", ".", "$0123456789", "D")
+			.add(double_type_flag, "$0123456789", ".", "d")
+			.add(double_type_flag, "$0123456789", ".", "D")
+			.add(double_type_flag, "-", ".", "$0123456789", "d")
+			.add(double_type_flag, "-", ".", "$0123456789", "D")
+			.add(double_type_flag, "+", ".", "$0123456789", "d")
+			.add(double_type_flag, "+", ".", "$0123456789", "D")
+			.add(double_type_flag, ".", "$0123456789", "d")
+			.add(double_type_flag, ".", "$0123456789", "D")
+			.add(double_type_flag, "+", "$0123456789", ".", "$0123456789")
+			.add(double_type_flag, "+", "$0123456789", ".")
+			.add(double_type_flag, "-", "$0123456789", ".", "$0123456789")
+			.add(double_type_flag, "-", "$0123456789", ".")
+			.add(double_type_flag, "$0123456789", ".", "$0123456789")
+			.add(double_type_flag, "$0123456789", ".")
+			.add(double_type_flag, "-", ".", "$0123456789")
+			.add(double_type_flag, "+", ".", "$0123456789")
+			.add(double_type_flag, ".", "$0123456789");
+	}();
+
+	class Lexeme;
+	class ExpressionLexeme;
+	class DefinitionTokenStructure;
+	class DefinitionTokenStructureDictionaryTreesQueue;
+
+	// Owns every grammar object. Lexemes, definition token structures, their
+	// lexeme arrays, trie nodes and queues all live in one ParserArena and
+	// are released together with the allocator.
+	class ParserAllocator
+	{
+	public:
+		ParserAllocator() = default;
+
+		ParserAllocator(const ParserAllocator&) = delete;
+		ParserAllocator& operator = (const ParserAllocator&) = delete;
+
+		Lexeme* createLexeme(const char* chars, const uint32_t length);
+
+		Lexeme* createLexeme(const char* chars);
+
+		Lexeme* createExpressionLexeme(const char* chars, const uint32_t length);
+
+		Lexeme* createExpressionLexeme(const char* chars);
+
+		template <typename... _String_lexemes>
+		DefinitionTokenStructure* createDefinitionTokenStructure(
+			const uint32_t user_data, 
+			_String_lexemes... lexemes
+		)
+		{
+			return m_arena.create<DefinitionTokenStructure>(this, user_data, lexemes...);
+		}
+
+		template <typename... _Trees>
+		DefinitionTokenStructureDictionaryTreesQueue* createDefinitionTokenStructureDictionaryTreesQueue(_Trees*... trees)
+		{
+			return m_arena.create<DefinitionTokenStructureDictionaryTreesQueue>(this, trees...);
+		}
+
+		template <typename _Type, typename... _Args>
+		_Type* create(_Args&&... args)
+		{
+			return m_arena.create<_Type>(std::forward<_Args>(args)...);
+		}
+
+		template <typename _Type>
+		_Type* allocateArray(const size_t count)
+		{
+			return m_arena.allocateArray<_Type>(count);
+		}
+
+		void release()
+		{
+			m_arena.release();
+		}
+
+		const ParserArena& getArena() const
+		{
+			return m_arena;
+		}
+
+	private:
+		ParserArena m_arena;
+	};
+
+	class Lexeme
+	{
+	public:
+		Lexeme() = default;
+
+		Lexeme(const char* chars, const uint32_t length) :
+			m_chars(chars),
+			m_length(length),
+			m_ull_length((m_length + static_cast<const uint32_t>(sizeof(const uint32_t))) 
+				/ static_cast<const uint32_t>(sizeof(const uint32_t)))
+		{
+
+		}
+
+		Lexeme(const char* chars) :
+			m_chars(chars),
+			m_length(static_cast<uint32_t>(strlen(chars))),
+			m_ull_length((m_length + static_cast<const uint32_t>(sizeof(const uint32_t))) 
+				/ static_cast<const uint32_t>(sizeof(const uint32_t)))
+		{
+
+		}
+
+		bool operator == (const Lexeme& lexeme) const
+		{
+			if (this->m_length != lexeme.m_length || 
+				this->m_chars == nullptr || lexeme.m_chars == nullptr)
+			{
+				return false;
+			}
+			for (uint32_t i = 0; i < this->m_ull_length; i++)
+			{
+				if (reinterpret_cast<const uint32_t*>(this->m_chars)[i] != 
+					reinterpret_cast<const uint32_t*>(lexeme.m_chars)[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool operator != (const Lexeme& lexeme) const
+		{
+			if (*this == lexeme)
+			{
+				return false;
+			}
+			else
+			{
+				return true;
+			}
+		}
+
+		bool operator < (const Lexeme& lexeme) const
+		{
+			uint32_t offset = 0;
+			if (this->m_length < lexeme.m_length)
+			{
+				return false;
+			}
+			else if (this->m_length > lexeme.m_length)
+			{
+				return true;
+			}
+			while (this->m_chars[offset] == lexeme.m_chars[offset])
+			{
+				offset++;
+				if (offset == this->m_length)
+				{
+					break;
+				}
+				if (offset == lexeme.m_length)
+				{
+					break;
+				}
+			}
+			if (this->m_chars[offset] < lexeme.m_chars[offset])
+			{
+				return true;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		bool compareStrict(const char* chars, const uint32_t length) const
+		{
+			if (this->m_length != length || this->m_chars == nullptr
+				|| chars == nullptr)
+			{
+				return false;
+			}
+			for (uint32_t i = 0; i < this->m_ull_length; i++)
+			{
+				if (reinterpret_cast<const uint32_t*>(this->m_chars)[i] != 
+					reinterpret_cast<const uint32_t*>(chars)[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool compareStrict(const char* chars) const
+		{
+			return this->compareStrict(chars, strlen(chars));
+		}
+
+		virtual bool compare(const char* chars, const uint32_t length) const
+		{
+			if (this->m_length != length || this->m_chars == nullptr 
+				|| chars == nullptr)
+			{
+				return false;
+			}
+			for (uint32_t i = 0; i < this->m_length; i++)
+			{
+				if (this->m_chars[i] != chars[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool compare(const char* chars) const
+		{
+			return this->compare(chars, strlen(chars));
+		}
+
+		virtual uint32_t getLength(const char* content) const
+		{
+			return m_length;
+		}
+
+		const char* getChars() const
+		{
+			return m_chars;
+		}
+
+		uint32_t getCharsLength() const
+		{
+			return m_length;
+		}
+
+		virtual bool isExpression() const
+		{
+			return false;
+		}
+
+	protected:
+		uint32_t m_length = 0;
+		uint32_t m_ull_length = 0;
+		const char* m_chars = nullptr;
+	};
+
+	class ExpressionLexeme : public Lexeme
+	{
+	public:
+		ExpressionLexeme() = default;
+
+		ExpressionLexeme(const char* chars, const uint32_t length) :
+			Lexeme(chars, length),
+			m_set(chars, length)
+		{
+
+		}
+
+		ExpressionLexeme(const char* chars) :
+			Lexeme(chars),
+			m_set(chars, m_length)
+		{
+
+		}
+
+		bool compare(const char* chars, const uint32_t length) const override
+		{
+			if (this->m_chars == nullptr || chars == nullptr)
+			{
+				return false;
+			}
+			for (uint32_t i = 0; i < length; i++)
+			{
+				if (!m_set.contains(chars[i]))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		uint32_t getLength(const char* content) const override
+		{
+			return m_set.span(content);
+		}
+
+		bool isExpression() const override
+		{
+			return true;
+		}
+
+		bool contains(const char c) const
+		{
+			return m_set.contains(c);
+		}
+
+		const CharacterSet& getCharacterSet() const
+		{
+			return m_set;
+		}
+
+	private:
+		CharacterSet m_set;
+	};
+
+	inline Lexeme* ParserAllocator::createLexeme(const char* chars, const uint32_t length)
+	{
+		return m_arena.create<Lexeme>(chars, length);
+	}
+
+	inline Lexeme* ParserAllocator::createLexeme(const char* chars)
+	{
+		return m_arena.create<Lexeme>(chars);
+	}
+
+	inline Lexeme* ParserAllocator::createExpressionLexeme(const char* chars, const uint32_t length)
+	{
+		return m_arena.create<ExpressionLexeme>(chars, length);
+	}
+
+	inline Lexeme* ParserAllocator::createExpressionLexeme(const char* chars)
+	{
+		return m_arena.create<ExpressionLexeme>(chars);
+	}
+
+	class LexemeComparer
+	{
+	public:
+		LexemeComparer() = default;
+
+		LexemeComparer(const Lexeme* ptr_lexeme) : 
+			m_ptr_lexeme(ptr_lexeme)
+		{
+
+		}
+
+		bool operator == (const LexemeComparer& lexeme_comp) const
+		{
+			return *this->m_ptr_lexeme == *lexeme_comp.m_ptr_lexeme;
+		}
+
+		bool operator != (const LexemeComparer& lexeme_comp) const
+		{
+			return *this->m_ptr_lexeme != *lexeme_comp.m_ptr_lexeme;
+		}
+
+		bool operator < (const LexemeComparer& lexeme_comp) const
+		{
+			return *this->m_ptr_lexeme < *lexeme_comp.m_ptr_lexeme;
+		}
+
+		const Lexeme* getLexeme() const
+		{
+			return m_ptr_lexeme;
+		}
+
+	private:
+		const Lexeme* m_ptr_lexeme = nullptr;
+	};
+
+	class DefinitionTokenStructure
+	{
+	public:
+		DefinitionTokenStructure() : 
+			m_lexemes(nullptr),
+			m_lexemes_count(0),
+			m_user_data(0)
+		{
+
+		}
+
+	private:
+		template <typename _String_lexeme>
+		void create(
+			ParserAllocator* ptr_allocator, 
+			const uint32_t offset, 
+			_String_lexeme lexeme)
+		{
+			if (lexeme[0] == '$')
+			{
+				m_lexemes[offset] = ptr_allocator->createExpressionLexeme(&lexeme[1]);
+			}
+			else
+			{
+				m_lexemes[offset] = ptr_allocator->createLexeme(lexeme);
+			}
+		}
+
+		template <typename _String_lexeme, typename... _String_lexemes>
+		void create(
+			ParserAllocator* ptr_allocator,
+			const uint32_t offset, 
+			_String_lexeme lexeme, 
+			_String_lexemes... lexemes
+		)
+		{
+			if (lexeme[0] == '$')
+			{
+				m_lexemes[offset] = ptr_allocator->createExpressionLexeme(&lexeme[1]);
+			}
+			else
+			{
+				m_lexemes[offset] = ptr_allocator->createLexeme(lexeme);
+			}
+			this->create<_String_lexemes...>(ptr_allocator, offset + 1, lexemes...);
+		}
+
+	public:
+		template <typename _String_lexeme, typename... _String_lexemes>
+		DefinitionTokenStructure(
+			ParserAllocator* ptr_allocator,
+			const uint32_t user_data,
+			_String_lexeme lexeme, 
+			_String_lexemes... lexemes
+		) :
+			m_lexemes_count(sizeof...(_String_lexemes) + 1),
+			m_lexemes(ptr_allocator->allocateArray<const Lexeme*>(m_lexemes_count)),
+			m_user_data(user_data)
+		{
+			this->create<_String_lexeme, _String_lexemes...>(ptr_allocator, 0, lexeme, lexemes...);
+		}
+
+		DefinitionTokenStructure(ParserAllocator* ptr_allocator, const StaticTokenPattern& pattern) :
+			m_lexemes_count(pattern.lexemes_count),
+			m_lexemes(ptr_allocator->allocateArray<const Lexeme*>(m_lexemes_count)),
+			m_user_data(pattern.user_data)
+		{
+			for (uint32_t i = 0; i < m_lexemes_count; i++)
+			{
+				this->create(ptr_allocator, i, pattern.lexemes[i]);
+			}
+		}
+
+		bool compare(const char* content) const
+		{
+			for (uint32_t i = 0; i < m_lexemes_count; i++)
+			{
+				const uint32_t lexeme_length = m_lexemes[i]->getLength(content);
+				if (!m_lexemes[i]->compare(content, lexeme_length))
+				{
+					return false;
+				}
+				content += lexeme_length;
+			}
+			return true;
+		}
+
+		uint32_t getLength(const char* content) const
+		{
+			uint32_t length = 0;
+			for (uint32_t i = 0; i < m_lexemes_count; i++)
+			{
+				const uint32_t lexeme_length = m_lexemes[i]->getLength(content);
+				length += lexeme_length;
+				content += lexeme_length;
+			}
+#if defined(PRS_STATS)
+			// Every byte was already read by the findByChars that chose
+			// this pattern.
+			if (m_counters != nullptr)
+			{
+				m_counters->add(m_counters->length_calls, 1);
+				m_counters->add(m_counters->bytes_reexamined, length);
+			}
+#endif
+			return length;
+		}
+
+		const Lexeme* getLexemeAt(const uint32_t index) const
+		{
+			return m_lexemes[index];
+		}
+
+		const uint32_t getLexemesCount() const
+		{
+			return m_lexemes_count;
+		}
+
+		const uint32_t getUserData() const
+		{
+			return m_user_data;
+		}
+
+#if defined(PRS_STATS)
+		void setCounters(MatchCounters* counters)
+		{
+			m_counters = counters;
+		}
+#endif
+
+		const uint32_t m_lexemes_count;
+		const Lexeme** m_lexemes;
+		const uint32_t m_user_data;
+		PRS_STATS_ONLY(MatchCounters* m_counters = nullptr;)
+	};
+
+	// Deterministic automaton compiled from the patterns of one tree.
+	// Expression lexemes are possessive (like ExpressionLexeme::getLength),
+	// a match must be followed by a terminator and, as in the trie walk, the
+	// pattern with the most lexemes wins. Bytes are folded into equivalence
+	// classes so the table holds states * classes cells.
+	//
+	// The tables are either built by compile() or borrowed from a grammar
+	// image by assign(); only the former knows the DefinitionTokenStructure
+	// behind an accept state, both know its user_data.
+	class DefinitionTokenStructureAutomaton
+	{
+	public:
+		static constexpr uint32_t dead_state = 0;
+		static constexpr uint32_t start_state = 1;
+
+		struct AcceptState
+		{
+			uint32_t user_data;
+			uint32_t lexemes_count;
+		};
+
+		DefinitionTokenStructureAutomaton() = default;
+
+		DefinitionTokenStructureAutomaton(const DefinitionTokenStructureAutomaton&) = delete;
+		DefinitionTokenStructureAutomaton& operator = (const DefinitionTokenStructureAutomaton&) = delete;
+
+		void compile(const std::vector<DefinitionTokenStructure*>& def_tok_structs);
+
+		// The tables must outlive the automaton.
+		void assign(
+			const uint8_t* byte_classes,
+			const uint32_t classes_count,
+			const uint32_t states_count,
+			const uint32_t* transitions,
+			const int32_t* accepts,
+			const AcceptState* accept_states,
+			const uint32_t accept_states_count
+		)
+		{
+			memcpy(m_byte_classes, byte_classes, sizeof(m_byte_classes));
+			m_classes_count = classes_count;
+			m_states_count = states_count;
+			m_transitions = transitions;
+			m_accepts = accepts;
+			m_accept_states = accept_states;
+			m_accept_states_count = accept_states_count;
+			m_transitions_storage.clear();
+			m_accepts_storage.clear();
+			m_accept_states_storage.clear();
+			m_def_tok_structs.clear();
+		}
+
+		uint32_t findByChars(
+			const char* chars,
+			DefinitionTokenStructure** pptr_def_tok_struct
+		) const
+		{
+			uint32_t length = 0;
+			const int32_t accept = this->scan(chars, length);
+			if (accept < 0 || m_def_tok_structs.empty())
+			{
+				return 0;
+			}
+			*pptr_def_tok_struct = m_def_tok_structs[accept];
+			return length;
+		}
+
+		// Length of the match, 0 if there is none.
+		uint32_t match(const char* chars, uint32_t& user_data) const
+		{
+			uint32_t length = 0;
+			const int32_t accept = this->scan(chars, length);
+			if (accept < 0)
+			{
+				return 0;
+			}
+			user_data = m_accept_states[accept].user_data;
+			return length;
+		}
+
+		// Scan state that survives between calls, for input that arrives in
+		// pieces. resume() returns false once no pattern can extend the
+		// match; the byte that killed it is not counted in offset.
+		struct Cursor
+		{
+			uint32_t state = start_state;
+			uint32_t offset = 0;
+			int32_t accept = -1;
+			uint32_t accept_length = 0;
+		};
+
+		bool resume(Cursor& cursor, const char* chars, const size_t length) const
+		{
+			if (m_classes_count == 0)
+			{
+				cursor.state = dead_state;
+			}
+			if (cursor.state == dead_state)
+			{
+				return false;
+			}
+			const uint8_t* content = reinterpret_cast<const uint8_t*>(chars);
+			for (size_t i = 0; i < length; i++)
+			{
+				const uint32_t cell = cursor.state * m_classes_count + m_byte_classes[content[i]];
+				const int32_t accept = m_accepts[cell];
+				if (accept >= 0 && cursor.offset != 0 && (cursor.accept < 0 ||
+					m_accept_states[accept].lexemes_count > m_accept_states[cursor.accept].lexemes_count))
+				{
+					cursor.accept = accept;
+					cursor.accept_length = cursor.offset;
+				}
+				cursor.state = m_transitions[cell];
+				if (cursor.state == dead_state)
+				{
+					return false;
+				}
+				cursor.offset++;
+			}
+			return true;
+		}
+
+		DefinitionTokenStructure* getAccepted(const Cursor& cursor) const
+		{
+			return cursor.accept < 0 || m_def_tok_structs.empty() ? nullptr : m_def_tok_structs[cursor.accept];
+		}
+
+		bool isAccepted(const Cursor& cursor) const
+		{
+			return cursor.accept >= 0;
+		}
+
+		uint32_t getAcceptedUserData(const Cursor& cursor) const
+		{
+			return m_accept_states[cursor.accept].user_data;
+		}
+
+		const uint8_t* getByteClasses() const
+		{
+			return m_byte_classes;
+		}
+
+		uint32_t getStatesCount() const
+		{
+			return m_states_count;
+		}
+
+		uint32_t getClassesCount() const
+		{
+			return m_classes_count;
+		}
+
+		const uint32_t* getTransitions() const
+		{
+			return m_transitions;
+		}
+
+		const int32_t* getAccepts() const
+		{
+			return m_accepts;
+		}
+
+		const AcceptState* getAcceptStates() const
+		{
+			return m_accept_states;
+		}
+
+		uint32_t getAcceptStatesCount() const
+		{
+			return m_accept_states_count;
+		}
+
+#if defined(PRS_STATS)
+		void setCounters(MatchCounters* counters)
+		{
+			m_counters = counters;
+		}
+#endif
+
+	private:
+		// Index of the accepted pattern, or -1.
+		int32_t scan(const char* chars, uint32_t& length) const
+		{
+			if (m_classes_count == 0)
+			{
+				return -1;
+			}
+			const uint8_t* content = reinterpret_cast<const uint8_t*>(chars);
+			int32_t best = -1;
+			uint32_t best_length = 0;
+			uint32_t state = start_state;
+			uint32_t offset = 0;
+			while (true)
+			{
+				const uint32_t cell = state * m_classes_count + m_byte_classes[content[offset]];
+				const int32_t accept = m_accepts[cell];
+				if (accept >= 0 && offset != 0 &&
+					(best < 0 || m_accept_states[accept].lexemes_count > m_accept_states[best].lexemes_count))
+				{
+					best = accept;
+					best_length = offset;
+				}
+				state = m_transitions[cell];
+				if (state == dead_state)
+				{
+					break;
+				}
+				offset++;
+			}
+#if defined(PRS_STATS)
+			// A state per byte read; bytes read past the accepted end, or
+			// all of them on a miss, are read again by whoever goes next.
+			if (m_counters != nullptr)
+			{
+				m_counters->add(m_counters->calls, 1);
+				m_counters->add(m_counters->nodes_visited, offset + 1);
+				m_counters->depth(offset + 1);
+				m_counters->add(m_counters->bytes_reexamined, offset - best_length);
+				m_counters->add(best < 0 ? m_counters->backtracks : m_counters->matches, 1);
+			}
+#endif
+			length = best_length;
+			return best;
+		}
+
+		uint8_t m_byte_classes[256] = {};
+		uint32_t m_classes_count = 0;
+		uint32_t m_states_count = 0;
+		const uint32_t* m_transitions = nullptr;
+		const int32_t* m_accepts = nullptr;
+		const AcceptState* m_accept_states = nullptr;
+		uint32_t m_accept_states_count = 0;
+		std::vector<uint32_t> m_transitions_storage;
+		std::vector<int32_t> m_accepts_storage;
+		std::vector<AcceptState> m_accept_states_storage;
+		std::vector<DefinitionTokenStructure*> m_def_tok_structs;
+		PRS_STATS_ONLY(MatchCounters* m_counters = nullptr;)
+	};
+
+	inline void DefinitionTokenStructureAutomaton::compile(const std::vector<DefinitionTokenStructure*>& def_tok_structs)
+	{
+		struct NfaState
+		{
+			uint32_t pattern;
+			uint32_t element;
+			uint32_t offset;
+
+			bool operator < (const NfaState& state) const
+			{
+				if (pattern != state.pattern)
+				{
+					return pattern < state.pattern;
+				}
+				if (element != state.element)
+				{
+					return element < state.element;
+				}
+				return offset < state.offset;
+			}
+
+			bool operator == (const NfaState& state) const
+			{
+				return pattern == state.pattern && element == state.element && offset == state.offset;
+			}
+		};
+
+		m_transitions_storage.clear();
+		m_accepts_storage.clear();
+		m_accept_states_storage.clear();
+		m_def_tok_structs = def_tok_structs;
+
+		// Split the byte range into classes that no lexeme can tell apart.
+		ByteClasses byte_classes;
+		byte_classes.split([](const char c) { return _priv::is_terminator(c); });
+		for (const DefinitionTokenStructure* def_tok_struct : def_tok_structs)
+		{
+			for (uint32_t i = 0; i < def_tok_struct->getLexemesCount(); i++)
+			{
+				const Lexeme* lexeme = def_tok_struct->getLexemeAt(i);
+				if (lexeme->isExpression())
+				{
+					byte_classes.split(static_cast<const ExpressionLexeme*>(lexeme)->getCharacterSet());
+				}
+				else
+				{
+					for (uint32_t l = 0; l < lexeme->getCharsLength(); l++)
+					{
+						const char key = lexeme->getChars()[l];
+						byte_classes.split([key](const char c) { return c == key; });
+					}
+				}
+			}
+		}
+		const uint32_t classes_count = byte_classes.getCount();
+		m_classes_count = classes_count;
+		for (uint32_t b = 0; b < 256; b++)
+		{
+			m_byte_classes[b] = byte_classes.getClass(static_cast<char>(b));
+		}
+
+		// Possessive step: a class lexeme keeps every byte it contains and
+		// only hands the byte over to the next lexeme when it does not.
+		auto step = [&](NfaState state, const char c, std::vector<NfaState>& next)
+		{
+			const DefinitionTokenStructure* def_tok_struct = def_tok_structs[state.pattern];
+			while (state.element < def_tok_struct->getLexemesCount())
+			{
+				const Lexeme* lexeme = def_tok_struct->getLexemeAt(state.element);
+				if (lexeme->isExpression())
+				{
+					if (static_cast<const ExpressionLexeme*>(lexeme)->contains(c))
+					{
+						next.push_back(state);
+						return;
+					}
+					state.element++;
+					continue;
+				}
+				if (lexeme->getCharsLength() == 0)
+				{
+					state.element++;
+					continue;
+				}
+				if (lexeme->getChars()[state.offset] == c)
+				{
+					if (++state.offset == lexeme->getCharsLength())
+					{
+						state.element++;
+						state.offset = 0;
+					}
+					next.push_back(state);
+				}
+				return;
+			}
+		};
+
+		auto accepts = [&](NfaState state, const char c)
+		{
+			const DefinitionTokenStructure* def_tok_struct = def_tok_structs[state.pattern];
+			while (state.element < def_tok_struct->getLexemesCount())
+			{
+				const Lexeme* lexeme = def_tok_struct->getLexemeAt(state.element);
+				if (state.offset != 0 || (lexeme->getCharsLength() != 0 &&
+					(!lexeme->isExpression() || static_cast<const ExpressionLexeme*>(lexeme)->contains(c))))
+				{
+					return false;
+				}
+				state.element++;
+			}
+			return true;
+		};
+
+		for (uint32_t i = 0; i < def_tok_structs.size(); i++)
+		{
+			m_accept_states_storage.push_back({
+				def_tok_structs[i]->getUserData(),
+				def_tok_structs[i]->getLexemesCount()
+			});
+		}
+
+		std::map<std::vector<NfaState>, uint32_t> state_ids;
+		std::vector<std::vector<NfaState>> states(2);
+		for (uint32_t i = 0; i < def_tok_structs.size(); i++)
+		{
+			states[start_state].push_back({ i, 0, 0 });
+		}
+		state_ids[states[dead_state]] = dead_state;
+		state_ids[states[start_state]] = start_state;
+
+		for (uint32_t id = 0; id < states.size(); id++)
+		{
+			m_transitions_storage.resize(states.size() * classes_count, dead_state);
+			m_accepts_storage.resize(states.size() * classes_count, -1);
+			for (uint32_t cls = 0; cls < classes_count; cls++)
+			{
+				const char c = byte_classes.getRepresentative(cls);
+				std::vector<NfaState> next;
+				int32_t accept = -1;
+				for (const NfaState& state : states[id])
+				{
+					step(state, c, next);
+					if (_priv::is_terminator(c) && accepts(state, c) && (accept < 0 ||
+						m_accept_states_storage[state.pattern].lexemes_count > m_accept_states_storage[accept].lexemes_count))
+					{
+						accept = static_cast<int32_t>(state.pattern);
+					}
+				}
+				std::sort(next.begin(), next.end());
+				next.erase(std::unique(next.begin(), next.end()), next.end());
+				auto it = state_ids.find(next);
+				if (it == state_ids.end())
+				{
+					it = state_ids.emplace(next, static_cast<uint32_t>(states.size())).first;
+					states.push_back(next);
+				}
+				m_transitions_storage[id * classes_count + cls] = it->second;
+				m_accepts_storage[id * classes_count + cls] = accept;
+			}
+		}
+		m_transitions_storage.resize(states.size() * classes_count, dead_state);
+		m_accepts_storage.resize(states.size() * classes_count, -1);
+
+		m_states_count = classes_count == 0 ? 0 : static_cast<uint32_t>(states.size());
+		m_transitions = m_transitions_storage.data();
+		m_accepts = m_accepts_storage.data();
+		m_accept_states = m_accept_states_storage.data();
+		m_accept_states_count = static_cast<uint32_t>(m_accept_states_storage.size());
+	}
+
+	class DefinitionTokenStructureDictionaryTree;
+
+	class DefinitionTokenStructureDictionaryTreeNode
+	{
+
+		friend class DefinitionTokenStructureDictionaryTree;
+
+	public:
+		DefinitionTokenStructureDictionaryTreeNode() = default;
+		
+
+		DefinitionTokenStructure* getDefinitionTokenStructure() const
+		{
+			return m_def_token_struct;
+		}
+
+		bool definitionTokenStructureEmpty() const
+		{
+			return m_def_token_struct == nullptr;
+		}
+
+		const Lexeme* getLexeme() const
+		{
+			return m_lexeme;
+		}
+
+		uint32_t getNextBegin() const
+		{
+			return m_next_begin;
+		}
+
+		uint32_t getNextCount() const
+		{
+			return m_next_count;
+		}
+
+		bool nextEmpty() const
+		{
+			return m_next_count == 0;
+		}
+
+	private:
+		DefinitionTokenStructure* m_def_token_struct = nullptr;
+		const Lexeme* m_lexeme = nullptr;
+		uint32_t m_next_begin = 0;
+		uint32_t m_next_count = 0;
+		uint32_t m_dispatch = 0;
+		uint32_t m_memo_slot = 0;
+	};
+
+	// Lengths of the expression lexemes scanned during one findByChars,
+	// keyed by (memo slot, position), so a lexeme several branches share
+	// is scanned once per position. Direct-mapped: a collision only costs
+	// a rescan. Only the valid mask is initialised, so an unused memo
+	// costs nothing.
+	class DefinitionTokenStructureDictionaryTreeMemo
+	{
+	public:
+		static constexpr uint32_t no_slot = 0;
+
+		template <typename _Scan>
+		uint32_t getLength(const uint32_t slot, const char* chars, const _Scan& scan)
+		{
+			const uint32_t index = static_cast<uint32_t>(slot * 7 + reinterpret_cast<uintptr_t>(chars)) & (capacity - 1);
+			Entry& entry = m_entries[index];
+			if ((m_valid & (1u << index)) == 0 || entry.chars != chars || entry.slot != slot)
+			{
+				m_valid |= 1u << index;
+				entry.chars = chars;
+				entry.slot = slot;
+				entry.length = scan();
+			}
+			return entry.length;
+		}
+
+	private:
+		static constexpr uint32_t capacity = 32;
+
+		struct Entry
+		{
+			const char* chars;
+			uint32_t slot;
+			uint32_t length;
+		};
+
+		uint32_t m_valid = 0;
+		Entry m_entries[capacity];
+	};
+
+	// Patterns share every common prefix of equal lexemes. After compile()
+	// the nodes sit in one array in breadth-first order, so the children of
+	// a node are the index range [next_begin, next_begin + next_count), and
+	// each node has a row of the dispatch table, indexed by the byte class
+	// of the next input byte, listing only the children that can match it.
+	class DefinitionTokenStructureDictionaryTree
+	{
+	public:
+		DefinitionTokenStructureDictionaryTree(ParserAllocator& allocator) :
+			m_allocator(allocator),
+			m_build_nodes(1)
+		{
+
+		}
+
+		void pushDefinitionTokenStructure(DefinitionTokenStructure* ptr_def_tok_struct)
+		{
+			const uint32_t lexemes_count = ptr_def_tok_struct->getLexemesCount();
+			uint32_t next_node = 0;
+			for (uint32_t i = 0; i < lexemes_count; i++)
+			{
+				const Lexeme* key_lexeme = ptr_def_tok_struct->getLexemeAt(i);
+				uint32_t child = 0;
+				for (const std::pair<const Lexeme*, uint32_t>& next : m_build_nodes[next_node].next)
+				{
+					if (sameKey(next.first, key_lexeme))
+					{
+						child = next.second;
+						break;
+					}
+				}
+				if (child == 0)
+				{
+					child = static_cast<uint32_t>(m_build_nodes.size());
+					m_build_nodes[next_node].next.emplace_back(key_lexeme, child);
+					m_build_nodes.emplace_back();
+				}
+				next_node = child;
+			}
+			if (m_build_nodes[next_node].def_token_struct == nullptr)
+			{
+				m_build_nodes[next_node].def_token_struct = ptr_def_tok_struct;
+			}
+			m_def_token_structs.push_back(ptr_def_tok_struct);
+			PRS_STATS_ONLY(ptr_def_tok_struct->setCounters(&m_counters);)
+			m_compiled = false;
+		}
+
+		void pushDefinitionTokenStructures(std::vector<DefinitionTokenStructure*> ptr_def_tok_structs)
+		{
+			for (auto ptr_def_tok_struct : ptr_def_tok_structs)
+			{
+				pushDefinitionTokenStructure(ptr_def_tok_struct);
+			}
+		}
+
+		void findByChars(
+			const char* chars, 
+			DefinitionTokenStructure** pptr_def_tok_struct,
+			const DefinitionTokenStructureDictionaryTreeNode& node,
+			DefinitionTokenStructureDictionaryTreeMemo& memo
+			PRS_STATS_ONLY(, MatchTrace& trace)
+		) const
+		{
+#if defined(PRS_STATS)
+			m_counters.add(m_counters.nodes_visited, 1);
+			m_counters.depth(trace.depth);
+#endif
+			if (node.m_def_token_struct != nullptr && _priv::is_terminator(chars[0]))
+			{
+				if (*pptr_def_tok_struct == nullptr ||
+					node.m_def_token_struct->getLexemesCount() > (*pptr_def_tok_struct)->getLexemesCount())
+				{
+					*pptr_def_tok_struct = node.m_def_token_struct;
+				}
+			}
+			const DefinitionTokenStructureDictionaryTreeDispatch& dispatch =
+				m_dispatch[node.m_dispatch + m_byte_classes.getClass(chars[0])];
+			for (uint32_t i = 0; i < dispatch.count; i++)
+			{
+				const DefinitionTokenStructureDictionaryTreeNode& next = m_nodes[m_dispatch_next[dispatch.begin + i]];
+
+				// An expression lexeme matches whatever span it scans, so
+				// only literals need the compare.
+				uint32_t lexeme_length = 0;
+				bool matched = true;
+				if (next.m_memo_slot != DefinitionTokenStructureDictionaryTreeMemo::no_slot)
+				{
+					lexeme_length = memo.getLength(next.m_memo_slot, chars, [&]()
+					{
+						const uint32_t length = next.m_lexeme->getLength(chars);
+						PRS_STATS_ONLY(this->countExamined(chars, length, trace);)
+						return length;
+					});
+				}
+				else
+				{
+					lexeme_length = next.m_lexeme->getLength(chars);
+					PRS_STATS_ONLY(this->countExamined(chars, lexeme_length, trace);)
+					matched = next.m_lexeme->compare(chars, lexeme_length);
+				}
+				if (matched)
+				{
+#if defined(PRS_STATS)
+					trace.depth++;
+					findByChars(&chars[lexeme_length], pptr_def_tok_struct, next, memo, trace);
+					trace.depth--;
+#else
+					findByChars(&chars[lexeme_length], pptr_def_tok_struct, next, memo);
+#endif
+				}
+				PRS_STATS_ONLY(else m_counters.add(m_counters.backtracks, 1);)
+			}
+		}
+
+		void findByChars(
+			const char* chars,
+			DefinitionTokenStructure** pptr_def_tok_struct
+		)
+		{
+			if (_priv::is_terminator(*chars))
+			{
+				return;
+			}
+			if (!m_compiled)
+			{
+				compile();
+			}
+			DefinitionTokenStructureDictionaryTreeMemo memo;
+#if defined(PRS_STATS)
+			m_counters.add(m_counters.calls, 1);
+			MatchTrace trace = { chars, 1 };
+			findByChars(chars, pptr_def_tok_struct, m_nodes[0], memo, trace);
+			if (*pptr_def_tok_struct != nullptr)
+			{
+				m_counters.add(m_counters.matches, 1);
+			}
+#else
+			findByChars(chars, pptr_def_tok_struct, m_nodes[0], memo);
+#endif
+		}
+
+		void compile();
+
+		const DefinitionTokenStructureAutomaton& getAutomaton() const
+		{
+			return m_automaton;
+		}
+
+		const std::vector<DefinitionTokenStructure*>& getDefinitionTokenStructures() const
+		{
+			return m_def_token_structs;
+		}
+
+		const DefinitionTokenStructureDictionaryTreeNode* getNodes() const
+		{
+			return m_nodes;
+		}
+
+		uint32_t getNodesCount() const
+		{
+			return m_nodes_count;
+		}
+
+		// Counts of the trie walk, the automaton and getLength of this
+		// tree's patterns; zeros unless built with PRS_STATS.
+		MatchStats getStats() const
+		{
+#if defined(PRS_STATS)
+			return m_counters.snapshot();
+#else
+			return {};
+#endif
+		}
+
+		void resetStats()
+		{
+			PRS_STATS_ONLY(m_counters.reset();)
+		}
+
+	private:
+
+		struct DefinitionTokenStructureDictionaryTreeDispatch
+		{
+			uint32_t begin;
+			uint32_t count;
+		};
+
+		struct BuildNode
+		{
+			DefinitionTokenStructure* def_token_struct = nullptr;
+			std::vector<std::pair<const Lexeme*, uint32_t>> next;
+		};
+
+		// Equal expression lexemes of different patterns share a slot.
+		static uint32_t getMemoSlot(std::vector<const Lexeme*>& memo_lexemes, const Lexeme* lexeme)
+		{
+			for (uint32_t i = 0; i < memo_lexemes.size(); i++)
+			{
+				if (sameKey(memo_lexemes[i], lexeme))
+				{
+					return i + 1;
+				}
+			}
+			memo_lexemes.push_back(lexeme);
+			return static_cast<uint32_t>(memo_lexemes.size());
+		}
+
+		static bool sameKey(const Lexeme* lexeme, const Lexeme* key_lexeme)
+		{
+			return lexeme->isExpression() == key_lexeme->isExpression() &&
+				lexeme->getCharsLength() == key_lexeme->getCharsLength() &&
+				memcmp(lexeme->getChars(), key_lexeme->getChars(), lexeme->getCharsLength()) == 0;
+		}
+
+#if defined(PRS_STATS)
+		// Sibling branches read the same bytes again.
+		void countExamined(const char* chars, const uint32_t length, MatchTrace& trace) const
+		{
+			if (chars < trace.examined_end)
+			{
+				const char* end = std::min(chars + length, trace.examined_end);
+				m_counters.add(m_counters.bytes_reexamined, static_cast<uint64_t>(end - chars));
+			}
+			trace.examined_end = std::max(trace.examined_end, chars + length);
+		}
+#endif
+
+		static bool canStartWith(const Lexeme* lexeme, const char c)
+		{
+			if (lexeme->isExpression() || lexeme->getCharsLength() == 0)
+			{
+				return true;
+			}
+			return lexeme->getChars()[0] == c;
+		}
+
+		ParserAllocator& m_allocator;
+		std::vector<BuildNode> m_build_nodes;
+		std::vector<DefinitionTokenStructure*> m_def_token_structs;
+		bool m_compiled = false;
+
+		ByteClasses m_byte_classes;
+		DefinitionTokenStructureDictionaryTreeNode* m_nodes = nullptr;
+		uint32_t m_nodes_count = 0;
+		DefinitionTokenStructureDictionaryTreeDispatch* m_dispatch = nullptr;
+		uint32_t* m_dispatch_next = nullptr;
+		DefinitionTokenStructureAutomaton m_automaton;
+		PRS_STATS_ONLY(mutable MatchCounters m_counters;)
+	};
+
+	inline void DefinitionTokenStructureDictionaryTree::compile()
+	{
+		// Expression lexemes may match zero bytes, so only literal first
+		// bytes split the classes; expression children sit in every row.
+		m_byte_classes = ByteClasses();
+		for (const BuildNode& build_node : m_build_nodes)
+		{
+			for (const std::pair<const Lexeme*, uint32_t>& next : build_node.next)
+			{
+				if (!next.first->isExpression() && next.first->getCharsLength() != 0)
+				{
+					const char key = next.first->getChars()[0];
+					m_byte_classes.split([key](const char c) { return c == key; });
+				}
+			}
+		}
+		const uint32_t classes_count = m_byte_classes.getCount();
+
+		std::vector<uint32_t> order(1, 0);
+		std::vector<uint32_t> positions(m_build_nodes.size(), 0);
+		for (uint32_t i = 0; i < order.size(); i++)
+		{
+			for (const std::pair<const Lexeme*, uint32_t>& next : m_build_nodes[order[i]].next)
+			{
+				positions[next.second] = static_cast<uint32_t>(order.size());
+				order.push_back(next.second);
+			}
+		}
+
+		m_nodes_count = static_cast<uint32_t>(order.size());
+		m_nodes = m_allocator.allocateArray<DefinitionTokenStructureDictionaryTreeNode>(m_nodes_count);
+		m_dispatch = m_allocator.allocateArray<DefinitionTokenStructureDictionaryTreeDispatch>(m_nodes_count * classes_count);
+		std::vector<uint32_t> dispatch_next;
+		std::vector<const Lexeme*> memo_lexemes;
+		for (uint32_t i = 0; i < m_nodes_count; i++)
+		{
+			const BuildNode& build_node = m_build_nodes[order[i]];
+			DefinitionTokenStructureDictionaryTreeNode& node = m_nodes[i];
+			node.m_def_token_struct = build_node.def_token_struct;
+			node.m_next_count = static_cast<uint32_t>(build_node.next.size());
+			node.m_next_begin = node.m_next_count == 0 ? 0 : positions[build_node.next.front().second];
+			node.m_dispatch = i * classes_count;
+			for (const std::pair<const Lexeme*, uint32_t>& next : build_node.next)
+			{
+				DefinitionTokenStructureDictionaryTreeNode& child = m_nodes[positions[next.second]];
+				child.m_lexeme = next.first;
+				if (next.first->isExpression())
+				{
+					child.m_memo_slot = this->getMemoSlot(memo_lexemes, next.first);
+				}
+			}
+			for (uint32_t cls = 0; cls < classes_count; cls++)
+			{
+				const char c = m_byte_classes.getRepresentative(cls);
+				DefinitionTokenStructureDictionaryTreeDispatch& dispatch = m_dispatch[node.m_dispatch + cls];
+				dispatch.begin = static_cast<uint32_t>(dispatch_next.size());
+				for (const std::pair<const Lexeme*, uint32_t>& next : build_node.next)
+				{
+					if (canStartWith(next.first, c))
+					{
+						dispatch_next.push_back(positions[next.second]);
+					}
+				}
+				dispatch.count = static_cast<uint32_t>(dispatch_next.size()) - dispatch.begin;
+			}
+		}
+		m_dispatch_next = m_allocator.allocateArray<uint32_t>(dispatch_next.size() + 1);
+		std::copy(dispatch_next.begin(), dispatch_next.end(), m_dispatch_next);
+
+		m_automaton.compile(m_def_token_structs);
+		PRS_STATS_ONLY(m_automaton.setCounters(&m_counters);)
+		m_compiled = true;
+	}
+
+	class DefinitionTokenStructureDictionaryTrees
+	{
+	private:
+		template <typename... _String_lexemes>
+		void add(
+			DefinitionTokenStructureDictionaryTree& tree,
+			const uint32_t user_data, 
+			_String_lexemes... lexemes
+		)
+		{
+			tree.pushDefinitionTokenStructure(m_allocator.createDefinitionTokenStructure(user_data, lexemes...));
+		}
+
+		template <uint32_t _Capacity>
+		void add(DefinitionTokenStructureDictionaryTree& tree, const StaticTokenTree<_Capacity>& patterns)
+		{
+			for (uint32_t i = 0; i < patterns.getPatternsCount(); i++)
+			{
+				tree.pushDefinitionTokenStructure(
+					m_allocator.create<DefinitionTokenStructure>(&m_allocator, patterns.getPatternAt(i)));
+			}
+		}
+
+	public:
+		DefinitionTokenStructureDictionaryTrees(ParserAllocator& allocator) : 
+			tree_type(allocator),
+			tree_variable_name(allocator),
+			tree_numeric(allocator),
+			tree_bkt_figure_open(allocator),
+			tree_bkt_figure_close(allocator),
+			tree_semicolon(allocator),
+			tree_assignment(allocator),
+			m_allocator(allocator)
+		{
+			this->add(tree_bkt_figure_open, builtin_tree_bkt_figure_open);
+			this->add(tree_bkt_figure_close, builtin_tree_bkt_figure_close);
+			this->add(tree_assignment, builtin_tree_assignment);
+			this->add(tree_semicolon, builtin_tree_semicolon);
+			this->add(tree_variable_name, builtin_tree_variable_name);
+			this->add(tree_type, builtin_tree_type);
+			this->add(tree_numeric, builtin_tree_numeric);
+
+			tree_type.compile();
+			tree_variable_name.compile();
+			tree_numeric.compile();
+			tree_bkt_figure_open.compile();
+			tree_bkt_figure_close.compile();
+			tree_semicolon.compile();
+			tree_assignment.compile();
+		}
+
+		DefinitionTokenStructureDictionaryTree tree_type;
+		DefinitionTokenStructureDictionaryTree tree_variable_name;
+		DefinitionTokenStructureDictionaryTree tree_numeric;
+		DefinitionTokenStructureDictionaryTree tree_bkt_figure_open;
+		DefinitionTokenStructureDictionaryTree tree_bkt_figure_close;
+		DefinitionTokenStructureDictionaryTree tree_semicolon;
+		DefinitionTokenStructureDictionaryTree tree_assignment;
+
+	private:
+		ParserAllocator& m_allocator;
+	};
+
+	class DefinitionTokenStructureDictionaryTreesQueue
+	{
+	public:
+		DefinitionTokenStructureDictionaryTreesQueue() = default;
+
+		template <typename _Tree, typename... _Trees>
+		DefinitionTokenStructureDictionaryTreesQueue(ParserAllocator* ptr_allocator, _Tree* tree, _Trees*... trees) : 
+			m_length(sizeof...(_Trees) + 1),
+			m_trees(ptr_allocator->allocateArray<DefinitionTokenStructureDictionaryTree*>(m_length))
+		{
+			this->create(0, tree, trees...);
+		}
+
+		uint32_t getLength() const
+		{
+			return m_length;
+		}
+
+		DefinitionTokenStructureDictionaryTree* getTreeAt(uint32_t index) const
+		{
+			return m_trees[index];
+		}
+
+		// Matches the trees in order, spaces between them skipped, and
+		// writes one user_data per tree into user_data, which must hold
+		// getLength() values. Each token is read once by its tree's
+		// automaton, which also gives its length, and nothing is allocated.
+		// The cursor stops on the first token that does not match.
+		bool match(const char** ptr_content, uint32_t* user_data, const uint32_t capacity) const
+		{
+			if (capacity < m_length)
+			{
+				return false;
+			}
+			const char* content = *ptr_content;
+			for (uint32_t i = 0; i < m_length; i++)
+			{
+				_priv::skip_space(&content);
+				const uint32_t length = m_trees[i]->getAutomaton().match(content, user_data[i]);
+				if (length == 0)
+				{
+					*ptr_content = content;
+					return false;
+				}
+				content += length;
+			}
+			*ptr_content = content;
+			return true;
+		}
+
+		std::vector<uint32_t> compare(const char** ptr_content) const
+		{
+			std::vector<uint32_t> user_data_queue(m_length);
+			if (!this->match(ptr_content, user_data_queue.data(), m_length))
+			{
+				return {};
+			}
+			return user_data_queue;
+		}
+
+	private:
+		template <typename _Tree>
+		void create(const uint32_t offset, _Tree* tree)
+		{
+			static_assert(std::is_same_v<_Tree, DefinitionTokenStructureDictionaryTree>);
+			static_assert(std::is_same_v<_Tree, DefinitionTokenStructureDictionaryTree>);
+			m_trees[offset] = tree;
+		}
+
+		template <typename _Tree, typename... _Trees>
+		void create(const uint32_t offset, _Tree* tree, _Trees*... trees)
+		{
+			static_assert(std::is_same_v<_Tree, DefinitionTokenStructureDictionaryTree>);
+			m_trees[offset] = tree;
+			this->create(offset + 1, trees...);
+		}
+
+		const uint32_t m_length;
+		DefinitionTokenStructureDictionaryTree** m_trees;
+	};
+}